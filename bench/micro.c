@@ -0,0 +1,566 @@
+///
+/// @file   micro.c
+/// @brief  盤面・評価・探索の基本処理のマイクロベンチマーク
+/// @author kentakuramochi
+///
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "board.h"
+#include "evaluator.h"
+#include "com.h"
+#include "random.h"
+#include "benchresult.h"
+
+///
+/// @def    EVAL_FILE
+/// @brief  評価値ファイル名
+///
+#define EVAL_FILE "eval.dat"
+
+///
+/// @def    NUM_POSITIONS
+/// @brief  局面数の既定値
+///
+#define NUM_POSITIONS 4096
+
+///
+/// @def    BATCH_SIZE
+/// @brief  1回の計測で処理する局面数
+/// @note   計時の誤差が無視できる程度にまとめて計測する
+///
+#define BATCH_SIZE 256
+
+///
+/// @def    NUM_PASSES
+/// @brief  全局面を計測する回数の既定値
+///
+#define NUM_PASSES 20
+
+///
+/// @def    WARMUP_PASSES
+/// @brief  計測前に全局面を処理する回数（キャッシュ・分岐予測を温める）
+///
+#define WARMUP_PASSES 2
+
+///
+/// @struct Context
+/// @brief  計測対象の局面
+///
+typedef struct {
+    Board     **boards; ///< 局面
+    int       *colors;  ///< 手番（有効手がある）
+    int       *moves;   ///< 有効手の1つ
+    int       num;      ///< 局面数
+    Board     *scratch; ///< 複製先
+    Evaluator *eval;    ///< 評価器
+    Com       *com;     ///< COM（評価値キャッシュなし）
+    volatile long long sink;    ///< 最適化で処理が除かれないよう結果を集める
+} Context;
+
+///
+/// @struct Benchmark
+/// @brief  計測項目
+///
+typedef struct {
+    const char *name;   ///< 名前
+    double (*run)(Context *ctx, int first, int last);   ///< 局面[first, last)を処理した時間[s]を返す
+    EvalKernel kernel;  ///< 局面評価の実装（使えない実装の項目は計測しない）
+} Benchmark;
+
+static double now(void);
+static int pick_move(const Board *board, int color, Random *random);
+static bool init_context(Context *ctx, int num, uint64_t seed);
+static void free_context(Context *ctx);
+static int compare_double(const void *a, const void *b);
+
+static double run_flip(Context *ctx, int first, int last);
+static double run_unflip(Context *ctx, int first, int last);
+static double run_flip_pattern(Context *ctx, int first, int last);
+static double run_unflip_pattern(Context *ctx, int first, int last);
+static double run_count_flips(Context *ctx, int first, int last);
+static double run_can_play(Context *ctx, int first, int last);
+static double run_copy(Context *ctx, int first, int last);
+static double run_reverse(Context *ctx, int first, int last);
+static double run_init_pattern(Context *ctx, int first, int last);
+static double run_evaluate(Context *ctx, int first, int last);
+static double run_sort_moves(Context *ctx, int first, int last);
+
+///
+/// @var    benchmarks
+/// @brief  計測項目の一覧
+///
+static const Benchmark benchmarks[] = {
+    { "Board_flip",           run_flip,           EVAL_KERNEL_AUTO },
+    { "Board_unflip",         run_unflip,         EVAL_KERNEL_AUTO },
+    { "Board_flip_pattern",   run_flip_pattern,   EVAL_KERNEL_AUTO },
+    { "Board_unflip_pattern", run_unflip_pattern, EVAL_KERNEL_AUTO },
+    { "Board_count_flips",    run_count_flips,    EVAL_KERNEL_AUTO },
+    { "Board_can_play",       run_can_play,       EVAL_KERNEL_AUTO },
+    { "Board_copy",           run_copy,           EVAL_KERNEL_AUTO },
+    { "Board_reverse",        run_reverse,        EVAL_KERNEL_AUTO },
+    { "Board_init_pattern",   run_init_pattern,   EVAL_KERNEL_AUTO },
+    { "Evaluator_evaluate",   run_evaluate,       EVAL_KERNEL_AUTO },
+    { "Evaluator_evaluate.scalar", run_evaluate,  EVAL_KERNEL_SCALAR },
+    { "Evaluator_evaluate.avx2",   run_evaluate,  EVAL_KERNEL_AVX2 },
+    { "Com_sort_moves",       run_sort_moves,     EVAL_KERNEL_AUTO },
+};
+
+///
+/// @fn     now
+/// @brief  計測用の時刻を取得する
+/// @return 時刻[s]
+///
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+/// @fn     pick_move
+/// @brief  有効手から一様にランダムに選ぶ
+/// @param[in]      board   盤面
+/// @param[in]      color   手番
+/// @param[in,out]  random  乱数生成器
+/// @return 着手座標（有効手がないときはNONE）
+///
+static int pick_move(const Board *board, int color, Random *random)
+{
+    uint64_t moves = Board_legal_moves(board, color);
+    int num = 0;
+
+    for (uint64_t m = moves; m; m &= (m - 1)) {
+        num++;
+    }
+    if (num == 0) {
+        return NONE;
+    }
+
+    // n番目の有効手を選ぶ
+    for (int n = Random_int(random, num); n > 0; n--) {
+        moves &= (moves - 1);
+    }
+
+    int bit = 0;
+    while (!((moves >> bit) & 1)) {
+        bit++;
+    }
+
+    return Board_pos(bit % BOARD_SIZE, bit / BOARD_SIZE);
+}
+
+///
+/// @fn     init_context
+/// @brief  ランダムな着手で計測対象の局面を生成する
+/// @param[out] ctx     計測対象
+/// @param[in]  num     局面数
+/// @param[in]  seed    乱数シード
+/// @retval true    生成成功
+/// @retval false   メモリ確保失敗
+///
+static bool init_context(Context *ctx, int num, uint64_t seed)
+{
+    memset(ctx, 0, sizeof(Context));
+
+    ctx->boards  = calloc(num, sizeof(Board *));
+    ctx->colors  = malloc(num * sizeof(int));
+    ctx->moves   = malloc(num * sizeof(int));
+    ctx->scratch = Board_create();
+    ctx->eval    = Evaluator_create();
+    if (!ctx->boards || !ctx->colors || !ctx->moves || !ctx->scratch || !ctx->eval) {
+        return false;
+    }
+    // 評価値ファイルがなければ評価値0のまま計測する
+    Evaluator_load(ctx->eval, EVAL_FILE);
+
+    // 並び替えの計測で評価値キャッシュにあたらないよう、キャッシュは使わない
+    ctx->com = Com_create(ctx->eval);
+    if (!ctx->com) {
+        return false;
+    }
+
+    Random random;
+    Random_init(&random, seed);
+
+    for (ctx->num = 0; ctx->num < num; ) {
+        Board *board = Board_create();
+        if (!board) {
+            return false;
+        }
+
+        // 序盤から終盤まで一様に、手番側に有効手のある局面を選ぶ
+        int turns = 1 + Random_int(&random, 55);
+        int color = BLACK;
+        int move  = NONE;
+
+        Board_init(board);
+        for (int t = 0; t <= turns; t++) {
+            move = pick_move(board, color, &random);
+            if (move == NONE) {
+                // パス
+                color = Board_opponent(color);
+                move  = pick_move(board, color, &random);
+                if (move == NONE) {
+                    break;
+                }
+            }
+            if (t < turns) {
+                Board_flip(board, color, move);
+                color = Board_opponent(color);
+            }
+        }
+
+        if (move == NONE) {
+            // 終局した局面は使わない
+            Board_delete(board);
+            continue;
+        }
+
+        Board_init_pattern(board);
+
+        ctx->boards[ctx->num] = board;
+        ctx->colors[ctx->num] = color;
+        ctx->moves[ctx->num]  = move;
+        ctx->num++;
+    }
+
+    return true;
+}
+
+///
+/// @fn     free_context
+/// @brief  計測対象の局面を破棄する
+/// @param[in,out]  ctx 計測対象
+///
+static void free_context(Context *ctx)
+{
+    for (int i = 0; ctx->boards && (i < ctx->num); i++) {
+        Board_delete(ctx->boards[i]);
+    }
+    free(ctx->boards);
+    free(ctx->colors);
+    free(ctx->moves);
+    if (ctx->com) {
+        Com_delete(ctx->com);
+    }
+    if (ctx->eval) {
+        Evaluator_delete(ctx->eval);
+    }
+    if (ctx->scratch) {
+        Board_delete(ctx->scratch);
+    }
+}
+
+///
+/// @fn     run_flip
+/// @brief  Board_flipを計測する
+/// @note   計測後に局面を元に戻す（戻す時間は含まない）
+///
+static double run_flip(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Board_flip(ctx->boards[i], ctx->colors[i], ctx->moves[i]);
+    }
+    double time = now() - start;
+
+    for (int i = first; i < last; i++) {
+        Board_unflip(ctx->boards[i]);
+    }
+
+    return time;
+}
+
+///
+/// @fn     run_unflip
+/// @brief  Board_unflipを計測する
+/// @note   計測前に着手しておく（着手の時間は含まない）
+///
+static double run_unflip(Context *ctx, int first, int last)
+{
+    for (int i = first; i < last; i++) {
+        Board_flip(ctx->boards[i], ctx->colors[i], ctx->moves[i]);
+    }
+
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Board_unflip(ctx->boards[i]);
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_flip_pattern
+/// @brief  Board_flip_patternを計測する
+/// @note   計測後に局面を元に戻す（戻す時間は含まない）
+///
+static double run_flip_pattern(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Board_flip_pattern(ctx->boards[i], ctx->colors[i], ctx->moves[i]);
+    }
+    double time = now() - start;
+
+    for (int i = first; i < last; i++) {
+        Board_unflip_pattern(ctx->boards[i]);
+    }
+
+    return time;
+}
+
+///
+/// @fn     run_unflip_pattern
+/// @brief  Board_unflip_patternを計測する
+/// @note   計測前に着手しておく（着手の時間は含まない）
+///
+static double run_unflip_pattern(Context *ctx, int first, int last)
+{
+    for (int i = first; i < last; i++) {
+        Board_flip_pattern(ctx->boards[i], ctx->colors[i], ctx->moves[i]);
+    }
+
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Board_unflip_pattern(ctx->boards[i]);
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_count_flips
+/// @brief  Board_count_flipsを計測する
+///
+static double run_count_flips(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Board_count_flips(ctx->boards[i], ctx->colors[i], ctx->moves[i]);
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_can_play
+/// @brief  Board_can_playを計測する
+///
+static double run_can_play(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Board_can_play(ctx->boards[i], Board_opponent(ctx->colors[i]));
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_copy
+/// @brief  Board_copyを計測する
+///
+static double run_copy(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        Board_copy(ctx->boards[i], ctx->scratch);
+        ctx->sink += Board_count_disks(ctx->scratch, EMPTY);
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_reverse
+/// @brief  Board_reverseを計測する
+/// @note   計測後に局面を元に戻す（戻す時間は含まない）
+///
+static double run_reverse(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        Board_reverse(ctx->boards[i]);
+    }
+    double time = now() - start;
+
+    for (int i = first; i < last; i++) {
+        Board_reverse(ctx->boards[i]);
+    }
+
+    return time;
+}
+
+///
+/// @fn     run_init_pattern
+/// @brief  Board_init_patternを計測する
+///
+static double run_init_pattern(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        Board_init_pattern(ctx->boards[i]);
+        ctx->sink += Board_pattern(ctx->boards[i], 0);
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_evaluate
+/// @brief  Evaluator_evaluateを計測する
+///
+static double run_evaluate(Context *ctx, int first, int last)
+{
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Evaluator_evaluate(ctx->eval, ctx->boards[i]);
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     run_sort_moves
+/// @brief  Com_sort_movesを計測する
+///
+static double run_sort_moves(Context *ctx, int first, int last)
+{
+    int moves[BOARD_SIZE * BOARD_SIZE];
+
+    double start = now();
+    for (int i = first; i < last; i++) {
+        ctx->sink += Com_sort_moves(ctx->com, ctx->boards[i], ctx->colors[i], moves);
+        ctx->sink += moves[0];
+    }
+
+    return now() - start;
+}
+
+///
+/// @fn     compare_double
+/// @brief  qsort用の比較関数（昇順）
+///
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    int      num    = NUM_POSITIONS;
+    int      passes = NUM_PASSES;
+    uint64_t seed   = 0;
+    const char *result_file = NULL;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "n:p:s:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                // -n positions: 局面数
+                num = atoi(optarg);
+                break;
+            case 'p':
+                // -p passes: 全局面を計測する回数
+                passes = atoi(optarg);
+                break;
+            case 's':
+                // -s seed: 局面生成の乱数シード
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                // -o file: 計測結果の出力先
+                result_file = optarg;
+                break;
+            default:
+                printf("usage: %s [-n positions] [-p passes] [-s seed] [-o result]\n", argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if ((num < BATCH_SIZE) || (passes < 1)) {
+        printf("positions must be %d or more, passes 1 or more\n", BATCH_SIZE);
+        return EXIT_FAILURE;
+    }
+    // 局面数はまとめて計測する単位の倍数とする
+    num -= num % BATCH_SIZE;
+
+    Context ctx;
+    if (!init_context(&ctx, num, seed)) {
+        printf("failed to create positions\n");
+        free_context(&ctx);
+        return EXIT_FAILURE;
+    }
+
+    int    batches = num / BATCH_SIZE;
+    int    samples = batches * passes;
+    double *ns = malloc(samples * sizeof(double));
+    BenchResult *result = result_file ? BenchResult_create() : NULL;
+    if (!ns || (result_file && !result)) {
+        free(ns);
+        free_context(&ctx);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d positions, %d samples of %d ops\n", num, samples, BATCH_SIZE);
+    printf("%-26s %10s %10s %10s\n", "benchmark", "min[ns]", "median[ns]", "p99[ns]");
+
+    for (size_t b = 0; b < (sizeof(benchmarks) / sizeof(benchmarks[0])); b++) {
+        const Benchmark *bench = &benchmarks[b];
+
+        // 実装を指定した項目は、その実装が使えるときのみ計測する
+        if (!Evaluator_set_kernel(ctx.eval, bench->kernel)) {
+            printf("%-26s %10s\n", bench->name, "n/a");
+            continue;
+        }
+
+        for (int p = 0; p < WARMUP_PASSES; p++) {
+            bench->run(&ctx, 0, num);
+        }
+
+        // 1回の計測の1操作あたりの時間を標本とする
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < batches; i++) {
+                ns[p * batches + i] = bench->run(&ctx, i * BATCH_SIZE, (i + 1) * BATCH_SIZE) * 1e9 / BATCH_SIZE;
+            }
+        }
+        qsort(ns, samples, sizeof(double), compare_double);
+
+        printf("%-26s %10.1f %10.1f %10.1f\n", bench->name,
+               ns[0], ns[samples / 2], ns[(int)((samples - 1) * 0.99)]);
+
+        // 外れ値に左右されないよう、標準偏差は四分位範囲から推定する
+        if (result) {
+            char name[64];
+            snprintf(name, sizeof(name), "micro.%s", bench->name);
+            double stddev = (ns[(samples * 3) / 4] - ns[samples / 4]) / 1.349;
+            BenchResult_add(result, name, "ns", ns[samples / 2], stddev, false);
+        }
+    }
+
+    int status = EXIT_SUCCESS;
+    if (result) {
+        if (!BenchResult_save(result, result_file)) {
+            printf("failed to write %s\n", result_file);
+            status = EXIT_FAILURE;
+        }
+        BenchResult_delete(result);
+    }
+
+    free(ns);
+    free_context(&ctx);
+
+    return status;
+}
@@ -0,0 +1,43 @@
+///
+/// @file   analyze.h
+/// @brief  局面集の並列解析
+/// @author kentakuramochi
+///
+
+#ifndef ANALYZE_H_
+#define ANALYZE_H_
+
+#include <stdbool.h>
+
+#include "com.h"
+
+///
+/// @struct AnalyzeSetting
+/// @brief  局面集の解析の設定
+///
+typedef struct {
+    int        threads;     ///< 解析スレッド数
+    int        mid_depth;   ///< 中盤探索の深さ
+    int        exact_depth; ///< 完全読みする空きマス数
+    int        multipv;     ///< 求める手数（1のとき最善手のみ）
+    int        node_budget; ///< 1局面あたりの探索ノード数の上限（0で無制限）
+    double     time_budget; ///< 1局面あたりの探索時間[s]の上限（0で無制限）
+} AnalyzeSetting;
+
+///
+/// @fn     analyze
+/// @brief  局面集の各局面をスレッド並列に解析し、最善手・評価値・ノード数・時間を入力順に出力する
+/// @param[in]  com     COM思考ルーチン（スレッドごとに複製して使う、評価値は共有）
+/// @param[in]  file    局面集ファイル名
+/// @param[in]  setting 解析の設定
+/// @retval true    すべての局面を解析
+/// @retval false   ファイルの入出力・メモリ確保に失敗、または形式が不正な局面がある
+/// @note   局面集は1行1局面で、Board_setの形式（A1からH8の64文字、続けて手番）とする
+///         `;`以降（.obf形式の解）は無視し、空行と`#`で始まる行は読み飛ばす
+///         出力は`<行番号> <ノード数> <時間[s]> <着手>:<石数差>...`の1行1局面で、
+///         multipvが2以上のときは評価値の高い順にその手数まで並べる（予算は使わない）
+///         有効手がないときは着手を`pass`とする
+///
+bool analyze(Com *com, const char *file, const AnalyzeSetting *setting);
+
+#endif // ANALYZE_H_
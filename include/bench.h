@@ -0,0 +1,30 @@
+///
+/// @file   bench.h
+/// @brief  ベンチマーク
+/// @author kentakuramochi
+///
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdbool.h>
+
+#include "com.h"
+#include "benchresult.h"
+
+///
+/// @fn     bench_endgame
+/// @brief  終盤局面集を完全読みし、石数差・最善手の検証と時間・ノード数・最初の手でのbetaカットの割合を計測する
+/// @param[in,out]  com         COM思考ルーチン（完全読みに設定し、終盤キャッシュを外す）
+/// @param[in]      file        局面集ファイル名
+/// @param[in]      json_file   結果のJSON出力先（NULLのとき出力しない）
+/// @param[in,out]  bench_result    毎秒のノード数・時間・ノード数を追加するベンチマーク結果（NULLのとき追加しない）
+/// @retval true    すべての局面で石数差と最善手が一致
+/// @retval false   不一致、またはファイルの入出力に失敗
+/// @note   局面集はFFO/Edaxの局面形式（.obf）で1行1局面とする
+///         `<A1からH8の64文字> <手番X/O>; <着手>:<石数差>; ...`
+///         石数差の最も大きい着手を最善手とし、その石数差を期待値とする。`#`で始まる行は読み飛ばす
+///
+bool bench_endgame(Com *com, const char *file, const char *json_file, BenchResult *bench_result);
+
+#endif // BENCH_H_
@@ -0,0 +1,79 @@
+///
+/// @file   benchresult.h
+/// @brief  ベンチマーク結果の記録と比較
+/// @author kentakuramochi
+///
+
+#ifndef BENCHRESULT_H_
+#define BENCHRESULT_H_
+
+#include <stdbool.h>
+
+///
+/// @typedef    BenchResult
+/// @brief      ベンチマーク結果
+/// @note   実行環境（gitのリビジョン、コンパイラ、コンパイルオプション、CPU）と
+///         計測項目ごとの計測値・標準偏差を持つ
+///
+typedef struct BenchResult_ BenchResult;
+
+///
+/// @fn     BenchResult_create
+/// @brief  空のベンチマーク結果を生成し、実行環境を記録する
+/// @return ベンチマーク結果（失敗時はNULL）
+///
+BenchResult *BenchResult_create(void);
+
+///
+/// @fn     BenchResult_delete
+/// @brief  ベンチマーク結果を破棄する
+/// @param[in,out]  result  ベンチマーク結果
+///
+void BenchResult_delete(BenchResult *result);
+
+///
+/// @fn     BenchResult_add
+/// @brief  計測値を追加する
+/// @param[in,out]  result  ベンチマーク結果
+/// @param[in]      name    計測項目名（空白・`"`を含まない）
+/// @param[in]      unit    単位
+/// @param[in]      value   計測値
+/// @param[in]      stddev  計測値の標準偏差（不明なときは0）
+/// @param[in]      higher_is_better    大きいほど良い値か
+/// @retval true    追加成功
+/// @retval false   メモリ確保失敗
+///
+bool BenchResult_add(BenchResult *result, const char *name, const char *unit,
+                     double value, double stddev, bool higher_is_better);
+
+///
+/// @fn     BenchResult_save
+/// @brief  ベンチマーク結果をJSON形式で書き出す
+/// @param[in]  result  ベンチマーク結果
+/// @param[in]  file    ファイル名
+/// @retval true    出力成功
+/// @retval false   出力失敗
+///
+bool BenchResult_save(const BenchResult *result, const char *file);
+
+///
+/// @fn     BenchResult_load
+/// @brief  BenchResult_saveで書き出したベンチマーク結果を読み込む
+/// @param[in]  file    ファイル名
+/// @return ベンチマーク結果（失敗時・計測項目が1つもないときはNULL）
+///
+BenchResult *BenchResult_load(const char *file);
+
+///
+/// @fn     BenchResult_compare
+/// @brief  2つのベンチマーク結果を比較し、計測項目ごとの変化を表示する
+/// @param[in]  base        基準の結果
+/// @param[in]  current     比較する結果
+/// @param[in]  threshold   許容する悪化の割合[%]
+/// @return 悪化した計測項目と、比較する結果にない計測項目の数
+/// @note   悪化の割合が閾値と、両者の標準偏差から求めた揺らぎ（2σ）の両方を超えたとき悪化とする
+///         基準にある計測項目が比較する結果にないときは悪化とみなし、比較する結果にのみある計測項目は比較しない
+///
+int BenchResult_compare(const BenchResult *base, const BenchResult *current, double threshold);
+
+#endif // BENCHRESULT_H_
@@ -9,6 +9,9 @@
 
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "pattern.h"
 
 ///
 /// @def    BOARD_SIZE
@@ -46,51 +49,12 @@ typedef enum {
 ///
 /// @enum   PatternId
 /// @brief  盤面の評価パターンを示すインデックス
-/// @note   evaluator.cの各評価パターンに対応
+/// @note   pattern.hのPATTERN_ID_LISTから生成する
 ///
 typedef enum {
-    PATTERN_ID_HV4_1 = 0,   ///< hor./vert.4
-    PATTERN_ID_HV4_2,
-    PATTERN_ID_HV4_3,
-    PATTERN_ID_HV4_4,
-    PATTERN_ID_HV3_1,       ///< hor./vert.3
-    PATTERN_ID_HV3_2,
-    PATTERN_ID_HV3_3,
-    PATTERN_ID_HV3_4,
-    PATTERN_ID_HV2_1,       ///< hor./vert.2
-    PATTERN_ID_HV2_2,
-    PATTERN_ID_HV2_3,
-    PATTERN_ID_HV2_4,
-    PATTERN_ID_DIAG8_1,     ///< diag8
-    PATTERN_ID_DIAG8_2,
-    PATTERN_ID_DIAG7_1,     ///< diag7
-    PATTERN_ID_DIAG7_2,
-    PATTERN_ID_DIAG7_3,
-    PATTERN_ID_DIAG7_4,
-    PATTERN_ID_DIAG6_1,     ///< diag6
-    PATTERN_ID_DIAG6_2,
-    PATTERN_ID_DIAG6_3,
-    PATTERN_ID_DIAG6_4,
-    PATTERN_ID_DIAG5_1,     ///< diag5
-    PATTERN_ID_DIAG5_2,
-    PATTERN_ID_DIAG5_3,
-    PATTERN_ID_DIAG5_4,
-    PATTERN_ID_DIAG4_1,     ///< diag4
-    PATTERN_ID_DIAG4_2,
-    PATTERN_ID_DIAG4_3,
-    PATTERN_ID_DIAG4_4,
-    PATTERN_ID_EDGE8_1,     ///< edge
-    PATTERN_ID_EDGE8_2,
-    PATTERN_ID_EDGE8_3,
-    PATTERN_ID_EDGE8_4,
-    PATTERN_ID_EDGE8_5,
-    PATTERN_ID_EDGE8_6,
-    PATTERN_ID_EDGE8_7,
-    PATTERN_ID_EDGE8_8,
-    PATTERN_ID_CORNER8_1,   ///< corner
-    PATTERN_ID_CORNER8_2,
-    PATTERN_ID_CORNER8_3,
-    PATTERN_ID_CORNER8_4,
+#define PATTERN_ID_ENUM(name, type, ...) PATTERN_ID_##name,
+    PATTERN_ID_LIST(PATTERN_ID_ENUM)
+#undef PATTERN_ID_ENUM
     NUM_PATTERN_ID          ///< パターン数
 } PatternId;
 
@@ -138,6 +102,18 @@ void Board_delete(Board *board);
 ///
 void Board_init(Board *board);
 
+///
+/// @fn     Board_set
+/// @brief  文字列で表した局面を盤面に設定する
+/// @param[out] board   盤面
+/// @param[in]  str     局面（A1, B1, ..., H8の順に黒`X`・白`O`・空き`-`の64文字、続けて手番`X`/`O`）
+/// @param[out] color   手番（手番の文字がないときは黒）
+/// @retval true    設定成功
+/// @retval false   形式が不正（盤面は変更しない）
+/// @note   空白と行の区切り`/`は読み飛ばす。黒は`*`、空きは`.`でもよい
+///
+bool Board_set(Board *board, const char *str, int *color);
+
 ///
 /// @fn     Board_disk
 /// @brief  盤面の状態を取得する
@@ -210,6 +186,31 @@ void Board_init_pattern(Board *board);
 ///
 int Board_pattern(const Board *board, int id);
 
+///
+/// @fn     Board_pattern_list
+/// @brief  全評価パターンの状態を取得する
+/// @param[in]  board   盤面
+/// @return パターン状態の配列（PatternId順、NUM_PATTERN_ID個）
+///
+const int *Board_pattern_list(const Board *board);
+
+///
+/// @fn     Board_hash
+/// @brief  盤面のハッシュ値を取得する
+/// @param[in]  board   盤面
+/// @return 石の配置に対するハッシュ値（手番は含まない）
+///
+uint64_t Board_hash(const Board *board);
+
+///
+/// @fn     Board_canonical_hash
+/// @brief  盤面の対称変換によらないハッシュ値を取得する
+/// @param[in]  board   盤面
+/// @return 回転・鏡映した8通りの盤面のハッシュ値の最小値（手番は含まない）
+/// @note   差分更新しないため探索中には使わない
+///
+uint64_t Board_canonical_hash(const Board *board);
+
 ///
 /// @fn     Board_flip_pattern
 /// @brief  パターン更新し着手する
@@ -253,6 +254,15 @@ void Board_reverse(Board *board);
 ///
 bool Board_can_play(const Board *board, int color);
 
+///
+/// @fn     Board_legal_moves
+/// @brief  有効手の一覧を取得する
+/// @param[in]  board   盤面
+/// @param[in]  color   手番
+/// @return 有効手のビット列（座標(x, y)をbit (y * BOARD_SIZE + x)で表す）
+///
+uint64_t Board_legal_moves(const Board *board, int color);
+
 ///
 /// @fn     Board_pos
 /// @brief  x, y座標から座標インデックスを取得する
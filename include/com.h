@@ -7,8 +7,34 @@
 #ifndef COM_H_
 #define COM_H_
 
+#include <stdio.h>
+#include <stdint.h>
+
 #include "board.h"
 #include "evaluator.h"
+#include "endcache.h"
+
+///
+/// @def    COM_STATS
+/// @brief  探索の詳細な統計（手数ごとの局面数・評価回数・カット数・終盤キャッシュ）を集計するか
+/// @note   0のとき集計処理をコンパイルせず、該当する統計は0のままとなる
+///
+#ifndef COM_STATS
+#define COM_STATS 1
+#endif
+
+///
+/// @def    COM_STATS_PLY
+/// @brief  手数ごとの局面数を集計する最大の手数
+///
+#define COM_STATS_PLY (BOARD_SIZE * BOARD_SIZE)
+
+///
+/// @def    COM_MAX_PLY
+/// @brief  最善手順の最大の手数
+/// @note   終盤探索の手順は着手とパスを合わせて空きマス数の2倍まで
+///
+#define COM_MAX_PLY (BOARD_SIZE * BOARD_SIZE * 2)
 
 ///
 /// @typedef    Com
@@ -16,6 +42,38 @@
 ///
 typedef struct Com_ Com;
 
+///
+/// @struct ComResult
+/// @brief  着手の解析結果
+///
+typedef struct {
+    int move;   ///< 着手座標
+    int value;  ///< 評価値（Com_get_nextmoveと同じ単位）
+} ComResult;
+
+///
+/// @struct ComStats
+/// @brief  探索の統計
+/// @note   Com_reset_statsからの累計
+///
+typedef struct {
+    uint64_t moves;         ///< 探索した手数（Com_get_nextmoveの呼び出し数）
+    uint64_t nodes;         ///< 探索ノード数（末端局面数）
+    uint64_t mid_nodes;     ///< 中盤探索のノード数
+    uint64_t end_nodes;     ///< 終盤探索（完全読み・必勝読み）のノード数
+    uint64_t ply_nodes[COM_STATS_PLY];  ///< 探索開始局面からの手数ごとの訪れた局面数（COM_STATS）
+    uint64_t evaluations;   ///< 中盤探索の末端での評価回数（COM_STATS）
+    uint64_t cutoffs;       ///< betaカット数（COM_STATS）
+    uint64_t first_cutoffs; ///< 最初に調べた手でのbetaカット数（COM_STATS）
+    uint64_t cache_probes;  ///< 評価値キャッシュの参照数
+    uint64_t cache_hits;    ///< 評価値キャッシュのヒット数
+    uint64_t endcache_probes;   ///< 終盤キャッシュの参照数（COM_STATS）
+    uint64_t endcache_hits;     ///< 終盤キャッシュのヒット数（COM_STATS）
+    double   time;          ///< 探索時間[s]
+    double   nps;           ///< 毎秒のノード数
+    double   first_cutoff_rate; ///< betaカットのうち最初に調べた手でのカットの割合
+} ComStats;
+
 ///
 /// @fn     Com_create
 /// @brief  COMを生成する
@@ -24,6 +82,14 @@ typedef struct Com_ Com;
 ///
 Com *Com_create(Evaluator* eval);
 
+///
+/// @fn     Com_clone
+/// @brief  同じ評価器・設定のCOMを生成する
+/// @param[in]  com     複製元のCOM
+/// @return COM（探索状態・キャッシュ内容は引き継がない）
+///
+Com *Com_clone(const Com *com);
+
 ///
 /// @fn     Com_delete
 /// @brief  COMを破棄する
@@ -41,6 +107,41 @@ void Com_delete(Com *com);
 ///
 void Com_set_level(Com *com, int mid_depth, int th_exact, int th_wld);
 
+///
+/// @fn     Com_set_budget
+/// @brief  1手あたりの探索の予算を設定する
+/// @param[in,out]  com     COM
+/// @param[in]      nodes   探索ノード数の上限（0で無制限）
+/// @param[in]      seconds 探索時間[s]の上限（0で無制限）
+/// @note   予算があるとき、中盤探索は設定した深さを上限に反復深化し、
+///         予算を超えたら直前に読み切った深さの最善手を返す（1手読みは打ち切らない）
+///         終盤探索する局面では、先に中盤探索を同じく反復深化し、残りの予算で終盤探索が終わったときのみその最善手を返す
+///         （終わらないときは中盤探索の最善手を返すため、中盤探索より浅い探索にはならない）
+///         ノード数の予算では同じ局面から常に同じ手を返すが、時間の予算では実行環境により変わる
+///
+void Com_set_budget(Com *com, int nodes, double seconds);
+
+///
+/// @fn     Com_set_cache
+/// @brief  評価値キャッシュを設定する
+/// @param[in,out]  com     COM
+/// @param[in]      size    キャッシュのエントリ数（2の冪乗に切り下げる、0で無効）
+/// @retval true    設定成功
+/// @retval false   キャッシュ確保失敗
+///
+bool Com_set_cache(Com *com, int size);
+
+///
+/// @fn     Com_set_endcache
+/// @brief  終盤キャッシュを設定する
+/// @param[in,out]  com     COM
+/// @param[in]      cache   終盤キャッシュ（NULLで無効、複数のCOMで共有できる）
+/// @param[in]      empties 終盤キャッシュを使う最大の空きマス数
+/// @note   終盤キャッシュはCOMより後に破棄すること
+///         Com_cloneで生成したCOMは同じ終盤キャッシュを共有する
+///
+void Com_set_endcache(Com *com, EndCache *cache, int empties);
+
 ///
 /// @fn     Com_get_nextmove
 /// @brief  次手を取得する
@@ -52,12 +153,94 @@ void Com_set_level(Com *com, int mid_depth, int th_exact, int th_wld);
 ///
 int Com_get_nextmove(Com *com, Board *board, int color, int *value);
 
+///
+/// @fn     Com_sort_moves
+/// @brief  有効手を探索で調べる順（1手読みの評価値の高い順）に並べる
+/// @param[in,out]  com     COM
+/// @param[in]      board   盤面
+/// @param[in]      color   手番
+/// @param[out]     moves   着手座標（有効手数ぶん）
+/// @return 有効手数
+/// @note   探索と同じく盤面の複製・候補手リストの作成を含む
+///
+int Com_sort_moves(Com *com, const Board *board, int color, int *moves);
+
+///
+/// @fn     Com_analyze
+/// @brief  有効手のうち評価値の高いk手とその評価値を1回の探索で求める
+/// @param[in,out]  com     COM
+/// @param[in]      board   盤面
+/// @param[in]      color   手番
+/// @param[in]      k       求める手数
+/// @param[out]     results 評価値の高い順の着手と評価値（k要素）
+/// @return 求めた手数（有効手数がkより少なければ有効手数）
+/// @note   完全読みの深さ以下は石数差、それ以外は中盤探索の深さの評価値を求める
+///         盤面の準備・キャッシュ・着手順は全着手で共有し、k手がそろった後は
+///         k番目の評価値を超える手のみ正確な評価値を求める。探索の予算は使わない
+///
+int Com_analyze(Com *com, const Board *board, int color, int k, ComResult *results);
+
+///
+/// @fn     Com_set_report
+/// @brief  反復ごとの探索結果の出力先を設定する
+/// @param[in,out]  com     COM
+/// @param[in]      fp      出力先（NULLで出力しない）
+/// @note   出力するときは中盤探索を1手読みから反復深化し、深さごとに
+///         深さ・評価値・ノード数・毎秒のノード数・最善手順を出力する
+///
+void Com_set_report(Com *com, FILE *fp);
+
+///
+/// @fn     Com_get_pv
+/// @brief  直前の探索の最善手順を取得する
+/// @param[in]  com     COM
+/// @param[out] moves   最善手順の着手座標（パスはNONE、COM_MAX_PLY要素）
+/// @return 最善手順の手数
+/// @note   予算で打ち切ったときは読み切れた深さの手順を返す
+///         終盤キャッシュで値の決まった局面以降の手順は含まない
+///
+int Com_get_pv(const Com *com, int *moves);
+
 ///
 /// @fn     Com_count_nodes
 /// @brief  直前に探索したノード数を取得する
 /// @param[in]  com     COM
 /// @return 探索したノード数
 ///
-int Com_count_nodes(const Com *com);
+uint64_t Com_count_nodes(const Com *com);
+
+///
+/// @fn     Com_count_total_nodes
+/// @brief  生成してから探索したノード数の累計を取得する
+/// @param[in]  com     COM
+/// @param[out] mid     中盤探索のノード数
+/// @param[out] end     終盤探索（完全読み・必勝読み）のノード数
+///
+void Com_count_total_nodes(const Com *com, unsigned long long *mid, unsigned long long *end);
+
+///
+/// @fn     Com_count_cache
+/// @brief  直前の探索での評価値キャッシュのヒット・ミス数を取得する
+/// @param[in]  com     COM
+/// @param[out] hit     ヒット数
+/// @param[out] miss    ミス数
+///
+void Com_count_cache(const Com *com, unsigned long long *hit, unsigned long long *miss);
+
+///
+/// @fn     Com_get_stats
+/// @brief  探索の統計を取得する
+/// @param[in]  com     COM
+/// @param[out] stats   前回Com_reset_statsを呼んでから（なければ生成してから）の統計
+///
+void Com_get_stats(const Com *com, ComStats *stats);
+
+///
+/// @fn     Com_reset_stats
+/// @brief  探索の統計を0に戻す
+/// @param[in,out]  com     COM
+/// @note   Com_count_total_nodesの累計も0に戻る
+///
+void Com_reset_stats(Com *com);
 
 #endif // COM_H_
@@ -0,0 +1,93 @@
+///
+/// @file   dataset.h
+/// @brief  学習用局面データセット
+/// @author kentakuramochi
+///
+
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+///
+/// @struct DatasetEntry
+/// @brief  データセットの1局面
+/// @note   局面は黒番に揃えて格納する（白番局面は色反転し、石数差の符号を反転する）
+///         対称な局面を含む同じ局面は1つにまとめ、出現回数と石数差の平均を持つ
+///
+typedef struct {
+    uint16_t index[NUM_PATTERN_ID]; ///< 各パターンIDのパターン状態
+    uint8_t  empties;               ///< 空きマス数
+    uint32_t weight;                ///< 同じ局面の出現回数
+    float    result;                ///< 終局時の石数差の平均（手番側 - 相手側）
+} DatasetEntry;
+
+///
+/// @typedef    Dataset
+/// @brief      学習用局面データセット
+///
+typedef struct Dataset_ Dataset;
+
+///
+/// @fn     Dataset_extract
+/// @brief  終局した対局の局面を取り出す
+/// @param[in,out]  board   終局時の盤面（着手をすべて戻した盤面となる）
+/// @param[in]      colors  各着手の手番色
+/// @param[in]      num     着手数
+/// @param[out]     entries 局面（num個、出現回数は1）
+/// @param[out]     hashes  各局面の対称変換によらないハッシュ値（num個）
+///
+void Dataset_extract(Board *board, const int *colors, int num, DatasetEntry *entries, uint64_t *hashes);
+
+///
+/// @fn     Dataset_build
+/// @brief  棋譜ファイルからデータセットファイルを作成する
+/// @param[in]  game_file       棋譜ファイル名（バイナリ形式・文字列形式）
+/// @param[in]  dataset_file    データセットファイル名
+/// @param[out] total           棋譜の局面数（NULL可）
+/// @param[out] num             書き出した局面数（重複を除く、NULL可）
+/// @retval true    作成成功
+/// @retval false   ファイルの入出力・メモリ確保に失敗
+/// @note   再生できない棋譜・結果の一致しない棋譜は除く
+///         棋譜を2回読み、1回目で局面ごとの出現回数・石数差を集計し、2回目で書き出す
+///
+bool Dataset_build(const char *game_file, const char *dataset_file, size_t *total, size_t *num);
+
+///
+/// @fn     Dataset_open
+/// @brief  データセットファイルをメモリへ割り当てる
+/// @param[in]  file    データセットファイル名
+/// @return データセット（失敗時はNULL）
+/// @note   局面は一括で読み込まず、参照時にファイルから読み出される（mmapのないWindowsでは一括で読み込む）
+///
+Dataset *Dataset_open(const char *file);
+
+///
+/// @fn     Dataset_close
+/// @brief  データセットを閉じる
+/// @param[in,out]  dataset データセット
+///
+void Dataset_close(Dataset *dataset);
+
+///
+/// @fn     Dataset_size
+/// @brief  データセットの局面数を取得する
+/// @param[in]  dataset データセット
+/// @return 局面数
+///
+size_t Dataset_size(const Dataset *dataset);
+
+///
+/// @fn     Dataset_entry
+/// @brief  データセットの局面を取得する
+/// @param[in]  dataset データセット
+/// @param[in]  i       局面番号 (0 <= i < Dataset_size)
+/// @return 局面
+///
+const DatasetEntry *Dataset_entry(const Dataset *dataset, size_t i);
+
+#endif // DATASET_H_
@@ -0,0 +1,88 @@
+///
+/// @file   endcache.h
+/// @brief  終盤探索結果のキャッシュ
+/// @author kentakuramochi
+///
+
+#ifndef ENDCACHE_H_
+#define ENDCACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///
+/// @typedef    EndCache
+/// @brief      終盤探索結果のキャッシュ
+/// @note   盤面・手番のハッシュ値をキーとするダイレクトマップ方式
+///         終局時の石数差の上下限を保持する（評価値に依存しないため、評価値の更新後も有効）
+///         複数スレッドから同時に参照・登録できる
+///
+typedef struct EndCache_ EndCache;
+
+///
+/// @fn     EndCache_create
+/// @brief  終盤キャッシュを生成する
+/// @param[in]  size    エントリ数（2の冪乗に切り下げる）
+/// @return 終盤キャッシュ
+///
+EndCache *EndCache_create(int size);
+
+///
+/// @fn     EndCache_delete
+/// @brief  終盤キャッシュを破棄する
+/// @param[in,out]  cache   終盤キャッシュ
+///
+void EndCache_delete(EndCache *cache);
+
+///
+/// @fn     EndCache_clear
+/// @brief  終盤キャッシュを空にする
+/// @param[in,out]  cache   終盤キャッシュ
+///
+void EndCache_clear(EndCache *cache);
+
+///
+/// @fn     EndCache_probe
+/// @brief  終盤キャッシュを参照する
+/// @param[in]  cache   終盤キャッシュ
+/// @param[in]  key     盤面・手番のハッシュ値
+/// @param[out] lower   石数差の下限
+/// @param[out] upper   石数差の上限
+/// @retval true    キャッシュにある
+/// @retval false   キャッシュにない
+///
+bool EndCache_probe(EndCache *cache, uint64_t key, int *lower, int *upper);
+
+///
+/// @fn     EndCache_store
+/// @brief  終盤キャッシュへ登録する
+/// @param[in,out]  cache   終盤キャッシュ
+/// @param[in]      key     盤面・手番のハッシュ値
+/// @param[in]      lower   石数差の下限
+/// @param[in]      upper   石数差の上限
+/// @note   同じ局面が登録済みのときは上下限を狭める
+///
+void EndCache_store(EndCache *cache, uint64_t key, int lower, int upper);
+
+///
+/// @fn     EndCache_load
+/// @brief  ファイルから終盤キャッシュへ読み込む
+/// @param[in,out]  cache   終盤キャッシュ
+/// @param[in]      file    ファイル名
+/// @retval true    読み込み成功
+/// @retval false   読み込み失敗
+/// @note   エントリ数が異なるファイルも読み込める（登録済みの内容に追加する）
+///
+bool EndCache_load(EndCache *cache, const char *file);
+
+///
+/// @fn     EndCache_save
+/// @brief  終盤キャッシュをファイルへ書き出す
+/// @param[in]  cache   終盤キャッシュ
+/// @param[in]  file    ファイル名
+/// @retval true    書き出し成功
+/// @retval false   書き出し失敗
+///
+bool EndCache_save(EndCache *cache, const char *file);
+
+#endif // ENDCACHE_H_
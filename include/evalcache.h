@@ -0,0 +1,62 @@
+///
+/// @file   evalcache.h
+/// @brief  局面評価値のキャッシュ
+/// @author kentakuramochi
+///
+
+#ifndef EVALCACHE_H_
+#define EVALCACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///
+/// @typedef    EvalCache
+/// @brief      評価値キャッシュ
+/// @note   盤面ハッシュ値をキーとするダイレクトマップ方式
+///
+typedef struct EvalCache_ EvalCache;
+
+///
+/// @fn     EvalCache_create
+/// @brief  評価値キャッシュを生成する
+/// @param[in]  size    エントリ数（2の冪乗に切り下げる）
+/// @return 評価値キャッシュ
+///
+EvalCache *EvalCache_create(int size);
+
+///
+/// @fn     EvalCache_delete
+/// @brief  評価値キャッシュを破棄する
+/// @param[in,out]  cache   評価値キャッシュ
+///
+void EvalCache_delete(EvalCache *cache);
+
+///
+/// @fn     EvalCache_clear
+/// @brief  評価値キャッシュを空にする
+/// @param[in,out]  cache   評価値キャッシュ
+///
+void EvalCache_clear(EvalCache *cache);
+
+///
+/// @fn     EvalCache_probe
+/// @brief  評価値キャッシュを参照する
+/// @param[in]  cache   評価値キャッシュ
+/// @param[in]  key     盤面ハッシュ値
+/// @param[out] value   評価値
+/// @retval true    キャッシュにある
+/// @retval false   キャッシュにない
+///
+bool EvalCache_probe(EvalCache *cache, uint64_t key, int *value);
+
+///
+/// @fn     EvalCache_store
+/// @brief  評価値キャッシュへ登録する
+/// @param[in,out]  cache   評価値キャッシュ
+/// @param[in]      key     盤面ハッシュ値
+/// @param[in]      value   評価値
+///
+void EvalCache_store(EvalCache *cache, uint64_t key, int value);
+
+#endif // EVALCACHE_H_
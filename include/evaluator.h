@@ -8,6 +8,7 @@
 #define EVALUATOR_H_
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "board.h"
 
@@ -17,6 +18,22 @@
 ///
 #define DISK_VALUE 1000
 
+///
+/// @def    NUM_FEATURE
+/// @brief  1局面あたりの評価値の参照数（全パターンID + パリティ）
+///
+#define NUM_FEATURE (NUM_PATTERN_ID + 1)
+
+///
+/// @enum   EvalKernel
+/// @brief  局面評価の実装
+///
+typedef enum {
+    EVAL_KERNEL_AUTO,   ///< 実行環境で使える最速の実装（既定）
+    EVAL_KERNEL_SCALAR, ///< スカラー版
+    EVAL_KERNEL_AVX2,   ///< AVX2版
+} EvalKernel;
+
 ///
 /// @typedef    Evaluator
 /// @brief      評価器
@@ -30,6 +47,16 @@ typedef struct Evaluator_ Evaluator;
 ///
 Evaluator *Evaluator_create(void);
 
+///
+/// @fn     Evaluator_fork
+/// @brief  評価値を共有し、学習用の集計を個別に持つ評価器を生成する
+/// @param[in]  eval    評価値を共有する評価器
+/// @return 評価器
+/// @note   元の評価器より先に破棄すること
+///         集計はEvaluator_mergeで元の評価器へ反映する
+///
+Evaluator *Evaluator_fork(Evaluator *eval);
+
 ///
 /// @fn     Evaluator_delete
 /// @brief  評価器を破棄する
@@ -57,6 +84,27 @@ bool Evaluator_load(Evaluator *eval, const char *file);
 ///
 bool Evaluator_save(Evaluator *eval, const char *file);
 
+///
+/// @fn     Evaluator_write_state
+/// @brief  評価値と学習用の集計を書き出す
+/// @param[in]  eval    評価器
+/// @param[in]  fp      出力先
+/// @retval true    出力成功
+/// @retval false   出力失敗
+/// @note   学習の途中経過の保存に使う（Evaluator_read_stateで復元する）
+///
+bool Evaluator_write_state(const Evaluator *eval, FILE *fp);
+
+///
+/// @fn     Evaluator_read_state
+/// @brief  Evaluator_write_stateで書き出した評価値と学習用の集計を読み込む
+/// @param[in,out]  eval    評価器
+/// @param[in]      fp      入力元
+/// @retval true    読み込み成功
+/// @retval false   読み込み失敗（評価値・集計は不定）
+///
+bool Evaluator_read_state(Evaluator *eval, FILE *fp);
+
 ///
 /// @fn     Evaluator_evaluate
 /// @brief  局面を評価する
@@ -66,6 +114,17 @@ bool Evaluator_save(Evaluator *eval, const char *file);
 ///
 int Evaluator_evaluate(Evaluator *eval, const Board *board);
 
+///
+/// @fn     Evaluator_set_kernel
+/// @brief  局面評価の実装を選ぶ
+/// @param[in,out]  eval    評価器
+/// @param[in]      kernel  実装
+/// @retval true    設定成功
+/// @retval false   ビルド・実行環境で使えない実装（設定は変えない）
+/// @note   実装によらず評価値は同じ。設定後にEvaluator_forkで生成した評価器は同じ実装を使う
+///
+bool Evaluator_set_kernel(Evaluator *eval, EvalKernel kernel);
+
 ///
 /// @fn     Evaluator_add
 /// @brief  局面を登録する
@@ -75,11 +134,77 @@ int Evaluator_evaluate(Evaluator *eval, const Board *board);
 ///
 void Evaluator_add(Evaluator *eval, const Board *board, int value);
 
+///
+/// @fn     Evaluator_add_sample
+/// @brief  パターン状態で表した局面を重み付きで登録する
+/// @param[out] eval    評価器
+/// @param[in]  index   各パターンIDのパターン状態
+/// @param[in]  empties 空きマス数
+/// @param[in]  value   現在の評価値（同じ局面の平均）
+/// @param[in]  weight  同じ局面の出現回数
+/// @return 評価値と評価器出力の差分
+/// @note   同じ局面をweight回Evaluator_addするのと同じ集計となる
+///
+double Evaluator_add_sample(Evaluator *eval, const uint16_t *index, int empties, double value, int weight);
+
 ///
 /// @fn     Evaluator_update
 /// @brief  評価値を更新する
 /// @param[out] eval    評価器
+/// @return 値が変化した評価値の数
+/// @note   前回の更新以降に登録された評価値位置のみを走査する
+///
+int Evaluator_update(Evaluator *eval);
+
+///
+/// @fn     Evaluator_merge
+/// @brief  分岐した評価器の集計を取り込む
+/// @param[in,out]  eval    評価器
+/// @param[in,out]  fork    Evaluator_forkで生成した評価器（集計は空になる）
+///
+void Evaluator_merge(Evaluator *eval, Evaluator *fork);
+
+///
+/// @fn     Evaluator_version
+/// @brief  評価値の版数を取得する
+/// @param[in]  eval    評価器
+/// @return 評価値の読み込み・更新のたびに変わる版数
+///
+int Evaluator_version(const Evaluator *eval);
+
+///
+/// @fn     Evaluator_num_weights
+/// @brief  評価値の総数を取得する
+/// @param[in]  eval    評価器
+/// @return 全進行段階の正規パターンの評価値数
+///
+int Evaluator_num_weights(const Evaluator *eval);
+
+///
+/// @fn     Evaluator_features
+/// @brief  パターン状態から局面が参照する評価値位置を求める
+/// @param[in]  eval        評価器
+/// @param[in]  index       各パターンIDのパターン状態
+/// @param[in]  empties     空きマス数
+/// @param[out] features    評価値位置（NUM_FEATURE個、0 <= n < Evaluator_num_weights）
+/// @note   局面の評価値は参照する評価値の総和となる
+///
+void Evaluator_features(const Evaluator *eval, const uint16_t *index, int empties, int *features);
+
+///
+/// @fn     Evaluator_get_weights
+/// @brief  評価値を取得する
+/// @param[in]  eval    評価器
+/// @param[out] weights 評価値（Evaluator_num_weights個）
+///
+void Evaluator_get_weights(const Evaluator *eval, double *weights);
+
+///
+/// @fn     Evaluator_set_weights
+/// @brief  評価値を設定する
+/// @param[in,out]  eval    評価器
+/// @param[in]      weights 評価値（Evaluator_num_weights個、範囲外の値は制限する）
 ///
-void Evaluator_update(Evaluator *eval);
+void Evaluator_set_weights(Evaluator *eval, const double *weights);
 
 #endif // EVALUATOR_H_
@@ -0,0 +1,103 @@
+///
+/// @file   hashslot.h
+/// @brief  複数スレッドから参照・登録できるハッシュ表のエントリ
+/// @author kentakuramochi
+///
+
+#ifndef HASHSLOT_H_
+#define HASHSLOT_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+///
+/// @def    HASHSLOT_EMPTY
+/// @brief  空エントリのデータ
+/// @note   登録するデータはこの値にならないよう上位bitを0とする
+///
+#define HASHSLOT_EMPTY UINT64_MAX
+
+///
+/// @struct HashSlot
+/// @brief  ハッシュ表のエントリ
+/// @note   check = key ^ data として書き込み、読み出し時に一致を確認する
+///         複数スレッドからの書き込みが競合しても不整合なエントリは無視される（ロックフリー）
+///         評価値キャッシュ・終盤キャッシュで同じ手順を使うため、ここにまとめる
+///
+typedef struct {
+    _Atomic uint64_t check; ///< キー検査値
+    _Atomic uint64_t data;  ///< データ
+} HashSlot;
+
+///
+/// @fn     HashSlot_create
+/// @brief  空のエントリの表を生成する
+/// @param[in]  size    エントリ数（2の冪乗に切り下げる）
+/// @param[out] mask    インデックスマスク（エントリ数 - 1）
+/// @return エントリの表（失敗時はNULL、free()で解放する）
+///
+HashSlot *HashSlot_create(int size, uint64_t *mask);
+
+///
+/// @fn     HashSlot_clear
+/// @brief  エントリの表を空にする
+/// @param[in,out]  slots   エントリの表
+/// @param[in]      mask    インデックスマスク
+///
+void HashSlot_clear(HashSlot *slots, uint64_t mask);
+
+///
+/// @fn     HashSlot_load
+/// @brief  キーに一致するエントリのデータを読み出す
+/// @param[in]  slot    エントリ
+/// @param[in]  key     キー
+/// @param[out] data    データ
+/// @retval true    キーに一致する
+/// @retval false   空、別のキー、または書き込みの競合したエントリ
+/// @note   探索の末端ごとに呼ぶため、呼び出しの負荷がないよう静的インライン関数とする
+///
+static inline bool HashSlot_load(HashSlot *slot, uint64_t key, uint64_t *data)
+{
+    uint64_t d     = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&slot->check, memory_order_relaxed);
+
+    if (((check ^ d) != key) || (d == HASHSLOT_EMPTY)) {
+        return false;
+    }
+
+    *data = d;
+
+    return true;
+}
+
+///
+/// @fn     HashSlot_store
+/// @brief  エントリへ書き込む
+/// @param[in,out]  slot    エントリ
+/// @param[in]      key     キー
+/// @param[in]      data    データ（HASHSLOT_EMPTY以外）
+///
+static inline void HashSlot_store(HashSlot *slot, uint64_t key, uint64_t data)
+{
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->check, key ^ data, memory_order_relaxed);
+}
+
+///
+/// @fn     HashSlot_peek
+/// @brief  キーによらずエントリを読み出す
+/// @param[in]  slot    エントリ
+/// @param[out] key     キー（書き込みの競合したエントリでは不正な値）
+/// @return データ（空エントリはHASHSLOT_EMPTY）
+///
+static inline uint64_t HashSlot_peek(HashSlot *slot, uint64_t *key)
+{
+    uint64_t data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+
+    *key = atomic_load_explicit(&slot->check, memory_order_relaxed) ^ data;
+
+    return data;
+}
+
+#endif // HASHSLOT_H_
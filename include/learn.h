@@ -10,16 +10,79 @@
 #include "board.h"
 #include "com.h"
 
+///
+/// @struct LearnSetting
+/// @brief  自己対局の設定
+///
+typedef struct {
+    int        iteration;   ///< 対局数
+    int        threads;     ///< 自己対局スレッド数
+    const char *eval_file;  ///< 評価値出力ファイル名
+    const char *game_file;  ///< 対局の保存先ファイル名（NULLのとき対局ごとに学習する）
+    const char *record_file;    ///< 学習しながら対局を追記する棋譜ファイル名（NULLのとき追記しない）
+    uint64_t   seed;        ///< 乱数シード
+    const char *metrics_file;   ///< 進捗の計測ファイル名（NULLのとき書き出さない）
+    const char *checkpoint_file;    ///< 途中経過ファイル名
+    bool       resume;      ///< 途中経過から再開するか
+    int        node_budget; ///< 1手あたりの探索ノード数の上限（0で無制限）
+    double     time_budget; ///< 1手あたりの探索時間[s]の上限（0で無制限）
+} LearnSetting;
+
 ///
 /// @fn     learn
 /// @brief  自己対局し評価値を学習する
-/// @param[in]  board       盤面
 /// @param[in]  evaluator   評価器
-/// @param[in]  com         COM思考ルーチン
-/// @param[in]  iteration   学習回数
-/// @param[in]  file        評価値出力ファイル名
+/// @param[in]  com         COM思考ルーチン（スレッドごとに複製して使う）
+/// @param[in]  setting     自己対局の設定
 /// @note   モンテカルロ法による強化学習、終局時の石数差を最大化する
+///         評価値はスレッド数によらず一定の対局数ごとに、対局番号順に集計して更新する
+///         （同じシードからはスレッド数によらず同じ対局・学習結果となる）
+///         保存先を指定したときは学習せず、棋譜をファイルへ追記する
+///         棋譜ファイルを指定したときは学習しながら棋譜を追記する（保存先・棋譜ファイルとも拡張子が.txtのとき文字列形式）
+///         計測ファイルを指定したときは100局ごとに対局・局面・探索ノードの毎秒の処理数、
+///         評価値の平均絶対誤差、更新した評価値の数、探索・更新時間を1行ずつ追記する
+///         （拡張子が.csvのときCSV形式、それ以外はJSON Lines形式）
+///         100局ごとに評価値・学習用の集計・シード・対局数を途中経過ファイルへ保存し、
+///         resume指定時はそこから対局を再開する（中断しなかったときと同じ結果となり、スレッド数は変えてもよい）
+///
+void learn(Evaluator *evaluator, Com *com, const LearnSetting *setting);
+
+///
+/// @fn     train
+/// @brief  保存した棋譜から評価値を学習する
+/// @param[in]  evaluator   評価器
+/// @param[in]  game_file   棋譜ファイル名（learnで保存したもの、または文字列形式）
+/// @param[in]  batch       評価値を更新する局数
+/// @param[in]  file        評価値出力ファイル名
+/// @retval true    学習成功
+/// @retval false   ファイルの入出力に失敗、または有効な棋譜がない（評価値ファイルは書き換えない）
+///
+bool train(Evaluator *evaluator, const char *game_file, const int batch, const char *file);
+
+///
+/// @struct FitSetting
+/// @brief  データセットからの学習の設定
+///
+typedef struct {
+    int        epochs;      ///< 全局面を走査する回数
+    int        batch;       ///< 評価値を更新する局面数（0のとき全局面）
+    double     rate;        ///< 学習率
+    int        threads;     ///< 学習スレッド数
+    const char *eval_file;  ///< 評価値出力ファイル名
+    uint64_t   seed;        ///< 乱数シード（更新単位の走査順序）
+} FitSetting;
+
+///
+/// @fn     fit
+/// @brief  局面データセットから勾配降下法で評価値を学習する
+/// @param[in]  evaluator       評価器（読み込んだ評価値を初期値とする）
+/// @param[in]  dataset_file    データセットファイル名（Dataset_buildで作成したもの）
+/// @param[in]  setting         学習設定
+/// @retval true    学習成功
+/// @retval false   ファイルの入出力・メモリ確保に失敗
+/// @note   評価値と終局時の石数差の二乗誤差を最小化する
+///         局面は各スレッドへ分割し、スレッドごとの勾配を更新のたびに集約する
 ///
-void learn(Board *board, Evaluator *evaluator, Com *com, const int iteration, const char* file);
+bool fit(Evaluator *evaluator, const char *dataset_file, const FitSetting *setting);
 
 #endif // LEARN_H_
@@ -0,0 +1,90 @@
+///
+/// @file   pattern.h
+/// @brief  評価パターンの定義
+/// @author kentakuramochi
+/// @note   パターンの種類・構成マスはこのファイルのみで定義する
+///         board.c（パターン差分表）、evaluator.c（評価値の展開・対称性・ファイル配置）は
+///         以下のリストをマクロ展開して生成する
+///
+
+#ifndef PATTERN_H_
+#define PATTERN_H_
+
+///
+/// @def    MAX_PATTERN_SQUARES
+/// @brief  1パターンを構成する最大マス数
+///
+#define MAX_PATTERN_SQUARES 10
+
+///
+/// @def    PATTERN_TYPE_LIST
+/// @brief  評価パターンの種類（評価値テーブルの単位）
+/// @note   X(種類名)として展開する。並び順が評価値ファイルでの配置順となる
+///         Logistelloのパターンを元に簡略化されたもの
+///         (http://www.es-cube.net/es-cube/reversi/sample/html/3_2.html)
+///
+#define PATTERN_TYPE_LIST(X) \
+    X(HV4)      /* hor./vert.4: 水平/垂直ラインパターン */ \
+    X(HV3)      /* hor./vert.3 */ \
+    X(HV2)      /* hor./vert.2 */ \
+    X(DIAG8)    /* diag8: 対角線パターン */ \
+    X(DIAG7)    /* diag7 */ \
+    X(DIAG6)    /* diag6 */ \
+    X(DIAG5)    /* diag5 */ \
+    X(DIAG4)    /* diag4 */ \
+    X(EDGE8)    /* edge: 辺パターン */ \
+    X(CORNER8)  /* corner: 角パターン */
+
+///
+/// @def    PATTERN_ID_LIST
+/// @brief  盤面上の評価パターン
+/// @note   X(パターンID名, 種類名, 構成マス...)として展開する
+///         構成マスは状態の下位桁から並べる（3進数: BLACK=1, WHITE=2, EMPTY=0）
+///         同じ種類のパターンは同数のマスで構成し、盤面の対称変換で互いに移り合うように並べる
+///         1マスに関わるパターンは最大6つ（board.cのNUM_PATTERN_DIFF）まで
+///
+#define PATTERN_ID_LIST(X) \
+    X(HV4_1,     HV4,     A4, B4, C4, D4, E4, F4, G4, H4) \
+    X(HV4_2,     HV4,     A5, B5, C5, D5, E5, F5, G5, H5) \
+    X(HV4_3,     HV4,     D1, D2, D3, D4, D5, D6, D7, D8) \
+    X(HV4_4,     HV4,     E1, E2, E3, E4, E5, E6, E7, E8) \
+    X(HV3_1,     HV3,     A3, B3, C3, D3, E3, F3, G3, H3) \
+    X(HV3_2,     HV3,     A6, B6, C6, D6, E6, F6, G6, H6) \
+    X(HV3_3,     HV3,     C1, C2, C3, C4, C5, C6, C7, C8) \
+    X(HV3_4,     HV3,     F1, F2, F3, F4, F5, F6, F7, F8) \
+    X(HV2_1,     HV2,     A2, B2, C2, D2, E2, F2, G2, H2) \
+    X(HV2_2,     HV2,     A7, B7, C7, D7, E7, F7, G7, H7) \
+    X(HV2_3,     HV2,     B1, B2, B3, B4, B5, B6, B7, B8) \
+    X(HV2_4,     HV2,     G1, G2, G3, G4, G5, G6, G7, G8) \
+    X(DIAG8_1,   DIAG8,   A1, B2, C3, D4, E5, F6, G7, H8) \
+    X(DIAG8_2,   DIAG8,   A8, B7, C6, D5, E4, F3, G2, H1) \
+    X(DIAG7_1,   DIAG7,   A2, B3, C4, D5, E6, F7, G8) \
+    X(DIAG7_2,   DIAG7,   B1, C2, D3, E4, F5, G6, H7) \
+    X(DIAG7_3,   DIAG7,   A7, B6, C5, D4, E3, F2, G1) \
+    X(DIAG7_4,   DIAG7,   B8, C7, D6, E5, F4, G3, H2) \
+    X(DIAG6_1,   DIAG6,   A3, B4, C5, D6, E7, F8) \
+    X(DIAG6_2,   DIAG6,   C1, D2, E3, F4, G5, H6) \
+    X(DIAG6_3,   DIAG6,   A6, B5, C4, D3, E2, F1) \
+    X(DIAG6_4,   DIAG6,   C8, D7, E6, F5, G4, H3) \
+    X(DIAG5_1,   DIAG5,   A4, B5, C6, D7, E8) \
+    X(DIAG5_2,   DIAG5,   D1, E2, F3, G4, H5) \
+    X(DIAG5_3,   DIAG5,   A5, B4, C3, D2, E1) \
+    X(DIAG5_4,   DIAG5,   D8, E7, F6, G5, H4) \
+    X(DIAG4_1,   DIAG4,   A5, B6, C7, D8) \
+    X(DIAG4_2,   DIAG4,   E1, F2, G3, H4) \
+    X(DIAG4_3,   DIAG4,   A4, B3, C2, D1) \
+    X(DIAG4_4,   DIAG4,   E8, F7, G6, H5) \
+    X(EDGE8_1,   EDGE8,   B2, G1, F1, E1, D1, C1, B1, A1) \
+    X(EDGE8_2,   EDGE8,   G2, B1, C1, D1, E1, F1, G1, H1) \
+    X(EDGE8_3,   EDGE8,   B7, G8, F8, E8, D8, C8, B8, A8) \
+    X(EDGE8_4,   EDGE8,   G7, B8, C8, D8, E8, F8, G8, H8) \
+    X(EDGE8_5,   EDGE8,   B2, A7, A6, A5, A4, A3, A2, A1) \
+    X(EDGE8_6,   EDGE8,   B7, A2, A3, A4, A5, A6, A7, A8) \
+    X(EDGE8_7,   EDGE8,   G2, H7, H6, H5, H4, H3, H2, H1) \
+    X(EDGE8_8,   EDGE8,   G7, H2, H3, H4, H5, H6, H7, H8) \
+    X(CORNER8_1, CORNER8, B3, A3, C2, B2, A2, C1, B1, A1) \
+    X(CORNER8_2, CORNER8, G3, H3, F2, G2, H2, F1, G1, H1) \
+    X(CORNER8_3, CORNER8, B6, A6, C7, B7, A7, C8, B8, A8) \
+    X(CORNER8_4, CORNER8, G6, H6, F7, G7, H7, F8, G8, H8)
+
+#endif // PATTERN_H_
@@ -0,0 +1,35 @@
+///
+/// @file   perft.h
+/// @brief  着手生成の検証・計測（perft）
+/// @author kentakuramochi
+///
+
+#ifndef PERFT_H_
+#define PERFT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+///
+/// @fn     perft
+/// @brief  指定した手数先までの局面数（末端ノード数）を数える
+/// @param[in,out]  board   盤面（終了時は元に戻る）
+/// @param[in]      color   手番
+/// @param[in]      depth   手数
+/// @param[in]      bulk    最後の1手は着手せず有効手数を数えるか
+/// @return 末端ノード数
+/// @note   パスも1手と数え、双方着手できない終局は1ノードとして数える
+///
+uint64_t perft(Board *board, int color, int depth, bool bulk);
+
+///
+/// @fn     perft_reference
+/// @brief  初期局面からの既知の末端ノード数を取得する
+/// @param[in]  depth   手数
+/// @return 末端ノード数（既知でないときは0）
+///
+uint64_t perft_reference(int depth);
+
+#endif // PERFT_H_
@@ -0,0 +1,56 @@
+///
+/// @file   random.h
+/// @brief  擬似乱数生成
+/// @author kentakuramochi
+///
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <stdint.h>
+
+///
+/// @struct Random
+/// @brief  擬似乱数生成器 (xoshiro256**)
+/// @note   状態は呼び出し側が持つ（スレッドごとに別の生成器を使う）
+///
+typedef struct {
+    uint64_t state[4];  ///< 内部状態
+} Random;
+
+///
+/// @fn     Random_init
+/// @brief  シードから乱数生成器を初期化する
+/// @param[out] random  乱数生成器
+/// @param[in]  seed    シード
+/// @note   同じシードからは常に同じ乱数列を生成する
+///
+void Random_init(Random *random, uint64_t seed);
+
+///
+/// @fn     Random_next
+/// @brief  64bitの乱数を取得する
+/// @param[in,out]  random  乱数生成器
+/// @return 乱数
+///
+uint64_t Random_next(Random *random);
+
+///
+/// @fn     Random_int
+/// @brief  指定した値未満の整数乱数を取得する
+/// @param[in,out]  random  乱数生成器
+/// @param[in]      max     乱数上限値 (0 <= n < max)
+/// @return 乱数
+///
+int Random_int(Random *random, int max);
+
+///
+/// @fn     Random_seed
+/// @brief  シードと番号から別系列のシードを求める
+/// @param[in]  seed    元のシード
+/// @param[in]  n       系列番号
+/// @return シード
+///
+uint64_t Random_seed(uint64_t seed, uint64_t n);
+
+#endif // RANDOM_H_
@@ -0,0 +1,175 @@
+///
+/// @file   record.h
+/// @brief  棋譜の入出力
+/// @author kentakuramochi
+///
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "board.h"
+
+///
+/// @def    MAX_RECORD_MOVES
+/// @brief  1局の最大着手数（パスは含まない）
+///
+#define MAX_RECORD_MOVES (BOARD_SIZE * BOARD_SIZE - 4)
+
+///
+/// @def    MAX_RECORD_TEXT
+/// @brief  文字列形式の棋譜の最大文字数（終端を含む）
+///
+#define MAX_RECORD_TEXT (MAX_RECORD_MOVES * 2 + 1)
+
+///
+/// @struct Record
+/// @brief  1局の棋譜
+/// @note   パスは記録しない（再生時に着手できない手番をパスとみなす）
+///
+typedef struct {
+    int num;                        ///< 着手数
+    int moves[MAX_RECORD_MOVES];    ///< 着手座標
+    int result;                     ///< 終局時の石数差（黒 - 白）
+} Record;
+
+///
+/// @fn     Record_init
+/// @brief  棋譜を空にする
+/// @param[out] record  棋譜
+///
+void Record_init(Record *record);
+
+///
+/// @fn     Record_add
+/// @brief  棋譜に着手を追加する
+/// @param[in,out]  record  棋譜
+/// @param[in]      pos     着手座標
+///
+void Record_add(Record *record, int pos);
+
+///
+/// @fn     Record_write
+/// @brief  棋譜をバイナリ形式で書き出す
+/// @param[in]  fp      出力ストリーム
+/// @param[in]  record  棋譜
+/// @retval true    出力成功
+/// @retval false   出力失敗
+/// @note   形式: 着手数（1バイト）、着手（1手1バイト: y * 8 + x）、石数差（符号付き1バイト）
+///
+bool Record_write(FILE *fp, const Record *record);
+
+///
+/// @fn     Record_read
+/// @brief  バイナリ形式の棋譜を1局読み込む
+/// @param[in]  fp      入力ストリーム
+/// @param[out] record  棋譜
+/// @retval true    読み込み成功
+/// @retval false   終端または不正な形式
+///
+bool Record_read(FILE *fp, Record *record);
+
+///
+/// @fn     Record_replay
+/// @brief  棋譜を初期局面から再生する
+/// @param[in]  record  棋譜
+/// @param[out] board   盤面（再生後の局面）
+/// @param[out] colors  各着手の手番色（NULL可）
+/// @retval true    全着手が有効手
+/// @retval false   無効な着手を含む（boardは無効手の直前の局面）
+///
+bool Record_replay(const Record *record, Board *board, int *colors);
+
+///
+/// @fn     Record_format
+/// @brief  棋譜を文字列形式（`f5d6c3...`）にする
+/// @param[in]  record  棋譜
+/// @param[out] text    文字列（MAX_RECORD_TEXTバイト）
+/// @note   1手を列`a`-`h`と行`1`-`8`の2文字で表し、パスは書かない
+///
+void Record_format(const Record *record, char *text);
+
+///
+/// @fn     Record_parse
+/// @brief  文字列形式の棋譜を読み取る
+/// @param[out] record  棋譜（石数差は0とする）
+/// @param[in]  text    文字列
+/// @retval true    読み取り成功
+/// @retval false   不正な形式
+/// @note   列は大文字でもよい。空白は読み飛ばす
+///
+bool Record_parse(Record *record, const char *text);
+
+///
+/// @fn     Record_write_text
+/// @brief  棋譜を文字列形式で1行書き出す
+/// @param[in]  fp      出力ストリーム
+/// @param[in]  record  棋譜
+/// @retval true    出力成功
+/// @retval false   出力失敗
+///
+bool Record_write_text(FILE *fp, const Record *record);
+
+///
+/// @fn     Record_is_text
+/// @brief  棋譜ファイルを文字列形式で書き出すか判定する
+/// @param[in]  file    ファイル名
+/// @retval true    文字列形式（拡張子`.txt`）
+/// @retval false   バイナリ形式
+///
+bool Record_is_text(const char *file);
+
+///
+/// @typedef    RecordReader
+/// @brief      棋譜ファイルを1局ずつ読み込み再生する読み込み器
+///
+typedef struct RecordReader_ RecordReader;
+
+///
+/// @fn     RecordReader_open
+/// @brief  棋譜ファイルを開く
+/// @param[in]  file    ファイル名
+/// @return 読み込み器（失敗時はNULL）
+/// @note   拡張子が`.txt`か、先頭が英字のファイルは文字列形式（1行1局、`#`で始まる行と空行は読み飛ばす）、
+///         それ以外はバイナリ形式（Record_write）とする
+///
+RecordReader *RecordReader_open(const char *file);
+
+///
+/// @fn     RecordReader_close
+/// @brief  棋譜ファイルを閉じる
+/// @param[in,out]  reader  読み込み器
+///
+void RecordReader_close(RecordReader *reader);
+
+///
+/// @fn     RecordReader_rewind
+/// @brief  棋譜ファイルの先頭に戻る
+/// @param[in,out]  reader  読み込み器
+///
+void RecordReader_rewind(RecordReader *reader);
+
+///
+/// @fn     RecordReader_next
+/// @brief  次の有効な棋譜を読み込み、初期局面から再生する
+/// @param[in,out]  reader  読み込み器
+/// @param[out]     record  棋譜（文字列形式は再生後の石数差を設定する）
+/// @param[out]     board   盤面（再生後の局面）
+/// @param[out]     colors  各着手の手番色（NULL可）
+/// @retval true    読み込み成功
+/// @retval false   ファイル終端、またはバイナリ形式の破損
+/// @note   形式が不正な・無効手を含む棋譜は読み飛ばし、その数を数える
+///
+bool RecordReader_next(RecordReader *reader, Record *record, Board *board, int *colors);
+
+///
+/// @fn     RecordReader_count_invalid
+/// @brief  読み飛ばした棋譜の数を取得する
+/// @param[in]  reader  読み込み器
+/// @return 形式が不正な・無効手を含む棋譜の数
+///
+long RecordReader_count_invalid(const RecordReader *reader);
+
+#endif // RECORD_H_
@@ -0,0 +1,53 @@
+///
+/// @file   safefile.h
+/// @brief  書き込み途中で中断しても壊れないファイル出力
+/// @author kentakuramochi
+///
+
+#ifndef SAFEFILE_H_
+#define SAFEFILE_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+///
+/// @fn     SafeFile_open
+/// @brief  ファイルを書き出し用に開く
+/// @param[in]  file    ファイル名
+/// @return 一時ファイル（失敗時はNULL）
+/// @note   書き出しは一時ファイル（ファイル名 + ".tmp"）へ行い、SafeFile_closeで置き換える
+///
+FILE *SafeFile_open(const char *file);
+
+///
+/// @fn     SafeFile_close
+/// @brief  一時ファイルを閉じ、書き出しに成功していれば元のファイルと置き換える
+/// @param[in,out]  fp      SafeFile_openで開いた一時ファイル
+/// @param[in]      file    ファイル名
+/// @param[in]      result  書き出しに成功したか
+/// @retval true    置き換え成功
+/// @retval false   書き出し・置き換えに失敗（元のファイルは変更されない）
+/// @note   ディスクへ書き込んでから名前を変更するため、中断時も元のファイルか新しいファイルのどちらかが残る
+///
+bool SafeFile_close(FILE *fp, const char *file, bool result);
+
+///
+/// @fn     SafeFile_sync
+/// @brief  書き出した内容をディスクへ書き込む
+/// @param[in,out]  fp  出力ストリーム
+/// @retval true    書き込み成功
+/// @retval false   書き込み失敗
+///
+bool SafeFile_sync(FILE *fp);
+
+///
+/// @fn     SafeFile_truncate
+/// @brief  ファイルを指定したバイト数に切り詰める
+/// @param[in,out]  fp      ストリーム
+/// @param[in]      size    バイト数
+/// @retval true    切り詰め成功
+/// @retval false   切り詰め失敗
+///
+bool SafeFile_truncate(FILE *fp, long size);
+
+#endif // SAFEFILE_H_
@@ -0,0 +1,85 @@
+///
+/// @file   trace.h
+/// @brief  探索の区間計測（Chrome trace形式）
+/// @author kentakuramochi
+///
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+
+///
+/// @def    USE_TRACE
+/// @brief  区間計測をコンパイルするか
+/// @note   0のときTRACE_*マクロは何も生成しない
+///
+#ifndef USE_TRACE
+#define USE_TRACE 0
+#endif
+
+///
+/// @def    TRACE_BEGIN
+/// @brief  区間の計測を開始する（必ず記録する）
+/// @param[in]  name    区間名（文字列リテラル）
+/// @param[in]  arg     区間の引数（記録しないときは負の値）
+///
+///
+/// @def    TRACE_SAMPLE_BEGIN
+/// @brief  区間の計測を開始する（標本化の間隔ごとに1回だけ記録する）
+/// @param[in]  name    区間名（文字列リテラル）
+/// @param[in]  arg     区間の引数（記録しないときは負の値）
+///
+///
+/// @def    TRACE_END
+/// @brief  直前に開始した区間の計測を終了する
+///
+#if USE_TRACE
+#define TRACE_BEGIN(name, arg)          Trace_begin((name), (arg), false)
+#define TRACE_SAMPLE_BEGIN(name, arg)   Trace_begin((name), (arg), true)
+#define TRACE_END()                     Trace_end()
+#else
+#define TRACE_BEGIN(name, arg)
+#define TRACE_SAMPLE_BEGIN(name, arg)
+#define TRACE_END()
+#endif
+
+///
+/// @fn     Trace_start
+/// @brief  区間計測を開始する
+/// @param[in]  sample  標本化の間隔（TRACE_SAMPLE_BEGINの区間はスレッドごとにこの回数に1回記録する）
+/// @retval true    開始成功
+/// @retval false   区間計測を含まないビルド（USE_TRACEが0）
+/// @note   スレッドを生成する前に呼ぶ
+///
+bool Trace_start(int sample);
+
+///
+/// @fn     Trace_stop
+/// @brief  区間計測を終了し、記録した区間をChrome trace形式（JSON）で書き出す
+/// @param[in]  file    出力先
+/// @retval true    出力成功
+/// @retval false   出力失敗、または開始していない
+/// @note   計測したスレッドがすべて終了してから呼ぶ
+///         スレッドごとの記録は最新のTRACE_BUFFER_SIZE区間のみ残る
+///
+bool Trace_stop(const char *file);
+
+///
+/// @fn     Trace_begin
+/// @brief  区間の計測を開始する
+/// @param[in]  name    区間名
+/// @param[in]  arg     区間の引数（記録しないときは負の値）
+/// @param[in]  sampled 標本化するか
+/// @note   TRACE_BEGIN・TRACE_SAMPLE_BEGINから呼ぶ
+///
+void Trace_begin(const char *name, int arg, bool sampled);
+
+///
+/// @fn     Trace_end
+/// @brief  直前に開始した区間の計測を終了し、スレッドの記録へ追加する
+/// @note   TRACE_ENDから呼ぶ
+///
+void Trace_end(void);
+
+#endif // TRACE_H_
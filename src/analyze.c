@@ -0,0 +1,315 @@
+///
+/// @file   analyze.c
+/// @brief  局面集の並列解析
+/// @author kentakuramochi
+///
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "analyze.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+///
+/// @def    MAX_LINE
+/// @brief  局面集の1行の最大文字数
+///
+#define MAX_LINE 256
+
+///
+/// @struct Position
+/// @brief  解析する局面と結果
+///
+typedef struct {
+    int       line;     ///< 局面集の行番号
+    char      text[MAX_LINE];   ///< 局面（盤面と手番）
+    bool      valid;    ///< 形式が正しいか
+    bool      done;     ///< 解析済みか
+    int       num;      ///< 求めた手数（0のときパス）
+    ComResult *moves;   ///< 評価値の高い順の着手と評価値
+    unsigned long long nodes;   ///< 探索ノード数
+    double    time;     ///< 時間[s]
+} Position;
+
+///
+/// @struct Analyzer
+/// @brief  解析スレッドが共有する局面と出力
+///
+typedef struct {
+    Position  *positions;   ///< 局面
+    int       num;          ///< 局面数
+    int       next;         ///< 次に解析する局面
+    int       written;      ///< 出力済みの局面数
+    int       multipv;      ///< 求める手数
+    pthread_mutex_t mutex;  ///< 局面の割り当て・出力の排他
+} Analyzer;
+
+///
+/// @struct Worker
+/// @brief  解析スレッド
+///
+typedef struct {
+    Analyzer  *analyzer;    ///< 共有する局面と出力
+    Com       *com;         ///< COM思考ルーチン（評価値は共有）
+    Board     *board;       ///< 盤面
+    pthread_t thread;       ///< スレッド
+    bool      running;      ///< スレッド実行中フラグ
+} Worker;
+
+static double now(void);
+static int load_positions(const char *file, Position **positions);
+static void analyze_position(Worker *worker, Position *position);
+static void write_position(const Position *position);
+static void *run_worker(void *arg);
+
+///
+/// @fn     now
+/// @brief  解析時間の計測用の時刻を取得する
+/// @return 時刻[s]
+///
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+/// @fn     load_positions
+/// @brief  局面集を読み込む
+/// @param[in]  file        局面集ファイル名
+/// @param[out] positions   局面（呼び出し側で解放する）
+/// @return 局面数（失敗時は-1）
+///
+static int load_positions(const char *file, Position **positions)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        printf("failed to open %s\n", file);
+        return -1;
+    }
+
+    char     line[MAX_LINE];
+    int      num = 0, capacity = 0;
+    int      line_no = 0;
+    Position *list = NULL;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+
+        // 長すぎる行の残りは読み飛ばす（形式が不正な局面となる）
+        if (!strchr(line, '\n') && !feof(fp)) {
+            int c;
+            while (((c = fgetc(fp)) != EOF) && (c != '\n')) {
+            }
+        }
+
+        // .obf形式の解は使わない
+        line[strcspn(line, ";\r\n")] = '\0';
+        const char *p = line + strspn(line, " \t");
+        if ((*p == '\0') || (*p == '#')) {
+            continue;
+        }
+
+        if (num == capacity) {
+            capacity = (capacity > 0) ? (capacity * 2) : 1024;
+            Position *grown = realloc(list, capacity * sizeof(Position));
+            if (!grown) {
+                free(list);
+                fclose(fp);
+                return -1;
+            }
+            list = grown;
+        }
+
+        Position *position = &list[num++];
+        memset(position, 0, sizeof(Position));
+        position->line = line_no;
+        strcpy(position->text, p);
+    }
+    fclose(fp);
+
+    *positions = list;
+
+    return num;
+}
+
+///
+/// @fn     analyze_position
+/// @brief  1局面を解析する
+/// @param[in,out]  worker      解析スレッド
+/// @param[in,out]  position    局面と結果
+///
+static void analyze_position(Worker *worker, Position *position)
+{
+    int color;
+
+    position->valid = Board_set(worker->board, position->text, &color);
+    if (!position->valid) {
+        return;
+    }
+
+    // 有効手がないときは探索しない
+    if (!Board_can_play(worker->board, color)) {
+        position->num = 0;
+        return;
+    }
+
+    double start = now();
+    if (worker->analyzer->multipv > 1) {
+        position->num = Com_analyze(worker->com, worker->board, color, worker->analyzer->multipv, position->moves);
+    } else {
+        position->moves[0].move = Com_get_nextmove(worker->com, worker->board, color, &position->moves[0].value);
+        position->num = 1;
+    }
+    position->time  = now() - start;
+    position->nodes = (unsigned long long)Com_count_nodes(worker->com);
+}
+
+///
+/// @fn     write_position
+/// @brief  1局面の解析結果を出力する
+/// @param[in]  position    局面と結果
+///
+static void write_position(const Position *position)
+{
+    if (!position->valid) {
+        printf("%d invalid\n", position->line);
+        return;
+    }
+
+    printf("%d %llu %.6f", position->line, position->nodes, position->time);
+    if (position->num == 0) {
+        printf(" pass");
+    }
+    for (int i = 0; i < position->num; i++) {
+        printf(" %c%c:%+.2f", POS2COL(position->moves[i].move), POS2ROW(position->moves[i].move),
+               (double)position->moves[i].value / DISK_VALUE);
+    }
+    printf("\n");
+}
+
+///
+/// @fn     run_worker
+/// @brief  未解析の局面を順に取り出して解析し、先頭から続けて解析済みの局面を出力する
+/// @param[in,out]  arg     解析スレッド (Worker *)
+/// @return NULL
+///
+static void *run_worker(void *arg)
+{
+    Worker   *worker   = arg;
+    Analyzer *analyzer = worker->analyzer;
+    Position *done     = NULL;
+
+    while (true) {
+        pthread_mutex_lock(&analyzer->mutex);
+
+        // 解析した局面を登録し、入力順に出力できるところまで出力する
+        if (done) {
+            done->done = true;
+            while ((analyzer->written < analyzer->num) && analyzer->positions[analyzer->written].done) {
+                write_position(&analyzer->positions[analyzer->written++]);
+            }
+        }
+
+        int index = analyzer->next;
+        if (index < analyzer->num) {
+            analyzer->next++;
+        }
+
+        pthread_mutex_unlock(&analyzer->mutex);
+
+        if (index >= analyzer->num) {
+            break;
+        }
+
+        done = &analyzer->positions[index];
+        analyze_position(worker, done);
+    }
+
+    return NULL;
+}
+
+bool analyze(Com *com, const char *file, const AnalyzeSetting *setting)
+{
+    Analyzer analyzer = { NULL, 0, 0, 0, ((setting->multipv > 1) ? setting->multipv : 1), PTHREAD_MUTEX_INITIALIZER };
+
+    analyzer.num = load_positions(file, &analyzer.positions);
+    if (analyzer.num < 0) {
+        return false;
+    }
+
+    int       threads = (setting->threads > 0) ? setting->threads : 1;
+    Worker    *workers = calloc(threads, sizeof(Worker));
+    ComResult *moves   = malloc(((size_t)analyzer.num * analyzer.multipv + 1) * sizeof(ComResult));
+    bool      result   = (workers && moves);
+
+    for (int i = 0; result && (i < analyzer.num); i++) {
+        analyzer.positions[i].moves = &moves[(size_t)i * analyzer.multipv];
+    }
+
+    // 完全読みの深さまでは必勝読みを使わない
+    Com_set_level(com, setting->mid_depth, setting->exact_depth, setting->exact_depth);
+    Com_set_budget(com, setting->node_budget, setting->time_budget);
+
+    // スレッドごとにCOM・盤面を持つ
+    for (int i = 0; result && (i < threads); i++) {
+        workers[i].analyzer = &analyzer;
+        workers[i].com      = Com_clone(com);
+        workers[i].board    = Board_create();
+        result = (workers[i].com && workers[i].board);
+    }
+    if (!result) {
+        printf("failed to create workers\n");
+    }
+
+    double start = now();
+
+    printf("# line nodes time[s] move:score...\n");
+    for (int i = 0; result && (i < threads); i++) {
+        workers[i].running = (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) == 0);
+    }
+    for (int i = 0; result && (i < threads); i++) {
+        if (workers[i].running) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    // スレッドを起動できなかったときは残りを呼び出し元で解析する
+    if (result && (analyzer.next < analyzer.num)) {
+        run_worker(&workers[0]);
+    }
+
+    double elapsed = now() - start;
+
+    unsigned long long nodes = 0;
+    int invalid = 0;
+    for (int i = 0; i < analyzer.num; i++) {
+        nodes   += analyzer.positions[i].nodes;
+        invalid += !analyzer.positions[i].valid;
+    }
+    if (result) {
+        printf("# %d positions, %d invalid, %llu nodes, %.3f s, %.0f nodes/s\n",
+               analyzer.num, invalid, nodes, elapsed, ((elapsed > 0) ? (nodes / elapsed) : 0.0));
+    }
+
+    for (int i = 0; workers && (i < threads); i++) {
+        if (workers[i].com) {
+            Com_delete(workers[i].com);
+        }
+        if (workers[i].board) {
+            Board_delete(workers[i].board);
+        }
+    }
+    free(workers);
+    free(moves);
+    free(analyzer.positions);
+    pthread_mutex_destroy(&analyzer.mutex);
+
+    return result && (invalid == 0);
+}
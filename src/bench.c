@@ -0,0 +1,287 @@
+///
+/// @file   bench.c
+/// @brief  ベンチマーク
+/// @author kentakuramochi
+///
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
+
+///
+/// @def    MAX_LINE
+/// @brief  局面集の1行の最大文字数
+///
+#define MAX_LINE 1024
+
+///
+/// @struct EndgameProblem
+/// @brief  終盤局面集の1局面
+///
+typedef struct {
+    char board[MAX_LINE];   ///< 局面（盤面と手番）
+    int  num;               ///< 石数差の分かっている着手数
+    int  moves[BOARD_SIZE * BOARD_SIZE];    ///< 着手座標
+    int  scores[BOARD_SIZE * BOARD_SIZE];   ///< 着手後の石数差（手番側 - 相手側）
+    int  score;             ///< 最善の石数差
+} EndgameProblem;
+
+///
+/// @struct EndgameResult
+/// @brief  終盤局面集の1局面の計測結果
+///
+typedef struct {
+    int    empties;     ///< 空きマス数
+    int    move;        ///< 最善手
+    int    score;       ///< 石数差
+    bool   ok;          ///< 石数差・最善手が一致したか
+    unsigned long long nodes;   ///< 探索ノード数
+    double time;        ///< 時間[s]
+    double first_cutoff_rate;   ///< betaカットのうち最初に調べた手でのカットの割合
+} EndgameResult;
+
+static bool parse_problem(const char *line, EndgameProblem *problem);
+static void move_name(int pos, char *name);
+static double now(void);
+static void write_endgame_json(FILE *fp, const EndgameResult *results, int num);
+
+///
+/// @fn     parse_problem
+/// @brief  局面集の1行を読み取る
+/// @param[in]  line    行
+/// @param[out] problem 局面
+/// @retval true    読み取り成功
+/// @retval false   空行・コメント行、または形式が不正
+///
+static bool parse_problem(const char *line, EndgameProblem *problem)
+{
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+    if ((*line == '\0') || (*line == '#')) {
+        return false;
+    }
+
+    // 最初の';'までが局面
+    const char *p = strchr(line, ';');
+    if (!p) {
+        return false;
+    }
+    memcpy(problem->board, line, p - line);
+    problem->board[p - line] = '\0';
+
+    // 続けて"着手:石数差"を';'で区切って並べる
+    problem->num = 0;
+    while (p && (problem->num < (BOARD_SIZE * BOARD_SIZE))) {
+        char col;
+        int  row, score;
+        if (sscanf(p + 1, " %c%d:%d", &col, &row, &score) == 3) {
+            col = (char)toupper((unsigned char)col);
+            if ((col >= 'A') && (col < ('A' + BOARD_SIZE)) && (row >= 1) && (row <= BOARD_SIZE)) {
+                problem->moves[problem->num]  = Board_pos(col - 'A', row - 1);
+                problem->scores[problem->num] = score;
+                problem->num++;
+            }
+        }
+        p = strchr(p + 1, ';');
+    }
+    if (problem->num == 0) {
+        return false;
+    }
+
+    problem->score = problem->scores[0];
+    for (int i = 1; i < problem->num; i++) {
+        if (problem->scores[i] > problem->score) {
+            problem->score = problem->scores[i];
+        }
+    }
+
+    return true;
+}
+
+///
+/// @fn     move_name
+/// @brief  着手座標を文字列にする
+/// @param[in]  pos     着手座標
+/// @param[out] name    文字列（3バイト以上、パスは"PS"）
+///
+static void move_name(int pos, char *name)
+{
+    if (pos == NONE) {
+        strcpy(name, "PS");
+    } else {
+        name[0] = (char)('A' + Board_x(pos));
+        name[1] = (char)('1' + Board_y(pos));
+        name[2] = '\0';
+    }
+}
+
+///
+/// @fn     now
+/// @brief  計測用の時刻を取得する
+/// @return 時刻[s]
+///
+static double now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+/// @fn     write_endgame_json
+/// @brief  終盤局面集の計測結果をJSONで書き出す
+/// @param[in]  fp      出力先
+/// @param[in]  results 計測結果
+/// @param[in]  num     局面数
+///
+static void write_endgame_json(FILE *fp, const EndgameResult *results, int num)
+{
+    unsigned long long nodes = 0;
+    double time = 0;
+    int    ok = 0;
+
+    fprintf(fp, "{\n  \"benchmark\": \"endgame\",\n  \"positions\": [\n");
+    for (int i = 0; i < num; i++) {
+        const EndgameResult *r = &results[i];
+        char name[3];
+        move_name(r->move, name);
+        fprintf(fp, "    {\"id\": %d, \"empties\": %d, \"move\": \"%s\", \"score\": %d, \"ok\": %s, "
+                    "\"nodes\": %llu, \"time\": %.6f, \"nps\": %.0f, \"first_cutoff_rate\": %.4f}%s\n",
+                (i + 1), r->empties, name, r->score, (r->ok ? "true" : "false"),
+                r->nodes, r->time, ((r->time > 0) ? (r->nodes / r->time) : 0.0), r->first_cutoff_rate,
+                ((i + 1) < num) ? "," : "");
+        nodes += r->nodes;
+        time  += r->time;
+        ok    += r->ok;
+    }
+    fprintf(fp, "  ],\n  \"total\": {\"positions\": %d, \"ok\": %d, \"nodes\": %llu, \"time\": %.6f, \"nps\": %.0f}\n}\n",
+            num, ok, nodes, time, ((time > 0) ? (nodes / time) : 0.0));
+}
+
+bool bench_endgame(Com *com, const char *file, const char *json_file, BenchResult *bench_result)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        printf("failed to open %s\n", file);
+        return false;
+    }
+
+    Board          *board = Board_create();
+    EndgameProblem problem;
+    EndgameResult  *results = NULL;
+    int            num = 0;
+    char           line[MAX_LINE];
+    bool           result = (board != NULL);
+
+    // 常に完全読みし、局面間で結果を再利用しない
+    Com_set_level(com, 1, (BOARD_SIZE * BOARD_SIZE), (BOARD_SIZE * BOARD_SIZE));
+    Com_set_endcache(com, NULL, 0);
+    Com_set_budget(com, 0, 0);
+
+    unsigned long long total_nodes = 0;
+    double total_time = 0;
+    int    total_ok = 0;
+    double nps_sum = 0, nps_sq_sum = 0;
+
+    printf("  # empties move score expect result          nodes    time[s]          nodes/s 1st-cut\n");
+    while (result && fgets(line, sizeof(line), fp)) {
+        int color;
+        if (!parse_problem(line, &problem)) {
+            continue;
+        }
+        if (!Board_set(board, problem.board, &color)) {
+            printf("invalid position : %s\n", problem.board);
+            result = false;
+            break;
+        }
+
+        EndgameResult *grown = realloc(results, (num + 1) * sizeof(EndgameResult));
+        if (!grown) {
+            result = false;
+            break;
+        }
+        results = grown;
+
+        EndgameResult *r = &results[num++];
+        int value;
+
+        r->empties = Board_count_disks(board, EMPTY);
+        ComStats stats;
+        Com_reset_stats(com);
+        double start = now();
+        r->move    = Com_get_nextmove(com, board, color, &value);
+        r->time    = now() - start;
+        r->nodes   = (unsigned long long)Com_count_nodes(com);
+        r->score   = value / DISK_VALUE;
+        Com_get_stats(com, &stats);
+        r->first_cutoff_rate = stats.first_cutoff_rate;
+
+        // 最善手は石数差の分かっている着手のうち最善の石数差となるもの
+        bool best = false;
+        for (int i = 0; i < problem.num; i++) {
+            if ((problem.moves[i] == r->move) && (problem.scores[i] == problem.score)) {
+                best = true;
+            }
+        }
+        r->ok = best && (r->score == problem.score);
+
+        char name[3];
+        move_name(r->move, name);
+        printf("%3d %7d %4s %+5d %+6d %6s %14llu %10.3f %16.0f %6.1f%%\n",
+               num, r->empties, name, r->score, problem.score, (r->ok ? "OK" : "NG"),
+               r->nodes, r->time, ((r->time > 0) ? (r->nodes / r->time) : 0.0),
+               r->first_cutoff_rate * 100);
+
+        total_nodes += r->nodes;
+        total_time  += r->time;
+        total_ok    += r->ok;
+
+        double nps = (r->time > 0) ? (r->nodes / r->time) : 0.0;
+        nps_sum    += nps;
+        nps_sq_sum += nps * nps;
+    }
+    fclose(fp);
+
+    printf("total %d / %d OK, %llu nodes, %.3f s, %.0f nodes/s\n",
+           total_ok, num, total_nodes, total_time, ((total_time > 0) ? (total_nodes / total_time) : 0.0));
+    if (total_ok < num) {
+        result = false;
+    }
+
+    if (json_file) {
+        FILE *out = fopen(json_file, "w");
+        if (out) {
+            write_endgame_json(out, results, num);
+            if (fclose(out) != 0) {
+                result = false;
+            }
+        } else {
+            printf("failed to open %s\n", json_file);
+            result = false;
+        }
+    }
+
+    // 毎秒のノード数の揺らぎは、局面ごとの値の平均の標準誤差とする
+    if (bench_result && (num > 1) && (total_time > 0)) {
+        double mean = nps_sum / num;
+        double var  = (nps_sq_sum / num - mean * mean) / (num - 1);
+        BenchResult_add(bench_result, "endgame.nps", "nodes/s", total_nodes / total_time,
+                        (var > 0) ? sqrt(var) : 0, true);
+        BenchResult_add(bench_result, "endgame.time", "s", total_time, 0, false);
+        BenchResult_add(bench_result, "endgame.nodes", "nodes", (double)total_nodes, 0, false);
+    }
+
+    free(results);
+    if (board) {
+        Board_delete(board);
+    }
+
+    return result;
+}
@@ -0,0 +1,352 @@
+///
+/// @file   benchresult.c
+/// @brief  ベンチマーク結果の記録と比較
+/// @author kentakuramochi
+///
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "benchresult.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+///
+/// @def    MAX_TEXT
+/// @brief  実行環境・計測項目名の最大文字数
+///
+#define MAX_TEXT 256
+
+///
+/// @def    BUILD_FLAGS
+/// @brief  コンパイルオプション（Makefileから与える）
+///
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+///
+/// @struct Metric
+/// @brief  計測項目
+///
+typedef struct {
+    char   name[MAX_TEXT];  ///< 計測項目名
+    char   unit[MAX_TEXT];  ///< 単位
+    double value;           ///< 計測値
+    double stddev;          ///< 標準偏差
+    bool   higher_is_better;    ///< 大きいほど良い値か
+} Metric;
+
+///
+/// @struct BenchResult_
+/// @brief  ベンチマーク結果
+///
+struct BenchResult_ {
+    char   revision[MAX_TEXT];  ///< gitのリビジョン
+    char   compiler[MAX_TEXT];  ///< コンパイラ
+    char   flags[MAX_TEXT];     ///< コンパイルオプション
+    char   cpu[MAX_TEXT];       ///< CPU
+    Metric *metrics;            ///< 計測項目
+    int    num;                 ///< 計測項目数
+};
+
+static void read_command(const char *command, char *text);
+static void read_cpu(char *text);
+static void copy_text(char *dst, const char *src);
+static bool find_string(const char *line, const char *key, char *text);
+static bool find_number(const char *line, const char *key, double *value);
+
+///
+/// @fn     copy_text
+/// @brief  JSONの文字列として書き出せるよう、`"`と`\`と制御文字を除いて複製する
+/// @param[out] dst 複製先（MAX_TEXTバイト）
+/// @param[in]  src 複製元
+///
+static void copy_text(char *dst, const char *src)
+{
+    int n = 0;
+
+    for (; *src && (n < (MAX_TEXT - 1)); src++) {
+        if ((*src != '"') && (*src != '\\') && ((unsigned char)*src >= ' ')) {
+            dst[n++] = *src;
+        }
+    }
+    dst[n] = '\0';
+}
+
+///
+/// @fn     read_command
+/// @brief  コマンドの出力の1行目を取得する
+/// @param[in]  command コマンド
+/// @param[out] text    出力（MAX_TEXTバイト、失敗時は"unknown"）
+///
+static void read_command(const char *command, char *text)
+{
+    char line[MAX_TEXT] = "";
+    FILE *fp = popen(command, "r");
+
+    if (fp) {
+        if (!fgets(line, sizeof(line), fp)) {
+            line[0] = '\0';
+        }
+        pclose(fp);
+    }
+
+    copy_text(text, line);
+    if (text[0] == '\0') {
+        strcpy(text, "unknown");
+    }
+}
+
+///
+/// @fn     read_cpu
+/// @brief  CPUのモデル名を取得する
+/// @param[out] text    モデル名（MAX_TEXTバイト、不明なときは"unknown"）
+///
+static void read_cpu(char *text)
+{
+    char line[MAX_TEXT];
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+
+    strcpy(text, "unknown");
+    if (!fp) {
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *colon = strchr(line, ':');
+        if ((strncmp(line, "model name", 10) == 0) && colon) {
+            colon++;
+            while (*colon == ' ') {
+                colon++;
+            }
+            copy_text(text, colon);
+            break;
+        }
+    }
+
+    fclose(fp);
+}
+
+BenchResult *BenchResult_create(void)
+{
+    BenchResult *result = calloc(1, sizeof(BenchResult));
+    if (!result) {
+        return NULL;
+    }
+
+    read_command("git describe --always --dirty 2>/dev/null", result->revision);
+#if defined(__clang__)
+    copy_text(result->compiler, __VERSION__);
+#elif defined(__GNUC__)
+    copy_text(result->compiler, "gcc " __VERSION__);
+#else
+    strcpy(result->compiler, "unknown");
+#endif
+    copy_text(result->flags, BUILD_FLAGS);
+    read_cpu(result->cpu);
+
+    return result;
+}
+
+void BenchResult_delete(BenchResult *result)
+{
+    if (!result) {
+        return;
+    }
+
+    free(result->metrics);
+    free(result);
+    result = NULL;
+}
+
+bool BenchResult_add(BenchResult *result, const char *name, const char *unit,
+                     double value, double stddev, bool higher_is_better)
+{
+    Metric *metrics = realloc(result->metrics, (result->num + 1) * sizeof(Metric));
+    if (!metrics) {
+        return false;
+    }
+    result->metrics = metrics;
+
+    Metric *m = &result->metrics[result->num++];
+    copy_text(m->name, name);
+    copy_text(m->unit, unit);
+    m->value  = value;
+    m->stddev = stddev;
+    m->higher_is_better = higher_is_better;
+
+    return true;
+}
+
+bool BenchResult_save(const BenchResult *result, const char *file)
+{
+    FILE *fp = fopen(file, "w");
+    if (!fp) {
+        return false;
+    }
+
+    // 読み込みのため、実行環境・計測項目は1行に1つ書き出す
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"revision\": \"%s\",\n", result->revision);
+    fprintf(fp, "  \"compiler\": \"%s\",\n", result->compiler);
+    fprintf(fp, "  \"flags\": \"%s\",\n", result->flags);
+    fprintf(fp, "  \"cpu\": \"%s\",\n", result->cpu);
+    fprintf(fp, "  \"metrics\": [\n");
+    for (int i = 0; i < result->num; i++) {
+        const Metric *m = &result->metrics[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.9g, \"stddev\": %.9g, \"higher_is_better\": %s}%s\n",
+                m->name, m->unit, m->value, m->stddev, (m->higher_is_better ? "true" : "false"),
+                ((i + 1) < result->num) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+
+    return (fclose(fp) == 0);
+}
+
+///
+/// @fn     find_string
+/// @brief  行からJSONの文字列の値を取り出す
+/// @param[in]  line    行
+/// @param[in]  key     キー
+/// @param[out] text    値（MAX_TEXTバイト）
+/// @retval true    キーがある
+/// @retval false   キーがない
+///
+static bool find_string(const char *line, const char *key, char *text)
+{
+    char pattern[MAX_TEXT];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+
+    const char *p = strstr(line, pattern);
+    if (!p) {
+        return false;
+    }
+    p += strlen(pattern);
+
+    const char *end = strchr(p, '"');
+    if (!end) {
+        return false;
+    }
+
+    int len = (int)(end - p);
+    if (len > (MAX_TEXT - 1)) {
+        len = MAX_TEXT - 1;
+    }
+    memcpy(text, p, len);
+    text[len] = '\0';
+
+    return true;
+}
+
+///
+/// @fn     find_number
+/// @brief  行からJSONの数値の値を取り出す
+/// @param[in]  line    行
+/// @param[in]  key     キー
+/// @param[out] value   値
+/// @retval true    キーがある
+/// @retval false   キーがない
+///
+static bool find_number(const char *line, const char *key, double *value)
+{
+    char pattern[MAX_TEXT];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+
+    const char *p = strstr(line, pattern);
+    if (!p) {
+        return false;
+    }
+
+    return (sscanf(p + strlen(pattern), "%lf", value) == 1);
+}
+
+BenchResult *BenchResult_load(const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        return NULL;
+    }
+
+    BenchResult *result = calloc(1, sizeof(BenchResult));
+    char        line[MAX_TEXT * 4];
+    char        name[MAX_TEXT], unit[MAX_TEXT];
+    double      value, stddev;
+
+    while (result && fgets(line, sizeof(line), fp)) {
+        if (find_string(line, "name", name)) {
+            if (!find_string(line, "unit", unit)) {
+                unit[0] = '\0';
+            }
+            if (!find_number(line, "stddev", &stddev)) {
+                stddev = 0;
+            }
+            if (!find_number(line, "value", &value) ||
+                !BenchResult_add(result, name, unit, value, stddev, (strstr(line, "\"higher_is_better\": true") != NULL))) {
+                BenchResult_delete(result);
+                result = NULL;
+            }
+        } else {
+            find_string(line, "revision", result->revision);
+            find_string(line, "compiler", result->compiler);
+            find_string(line, "flags", result->flags);
+            find_string(line, "cpu", result->cpu);
+        }
+    }
+
+    fclose(fp);
+
+    // 計測項目のないファイルはベンチマーク結果ではないか、書き出し途中で途切れている
+    if (result && (result->num == 0)) {
+        BenchResult_delete(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+int BenchResult_compare(const BenchResult *base, const BenchResult *current, double threshold)
+{
+    int regressions = 0;
+
+    printf("base    : %s (%s, %s)\n", base->revision, base->compiler, base->cpu);
+    printf("current : %s (%s, %s)\n", current->revision, current->compiler, current->cpu);
+    if (strcmp(base->cpu, current->cpu) != 0) {
+        printf("warning: results were measured on different CPUs\n");
+    }
+    printf("%-32s %14s %14s %9s\n", "metric", "base", "current", "change");
+
+    for (int i = 0; i < base->num; i++) {
+        const Metric *b = &base->metrics[i];
+        const Metric *c = NULL;
+        for (int j = 0; j < current->num; j++) {
+            if (strcmp(b->name, current->metrics[j].name) == 0) {
+                c = &current->metrics[j];
+                break;
+            }
+        }
+        // 基準にある計測項目がないときは、ベンチマークが実行されなかったとみなす
+        if (!c) {
+            printf("%-32s %14.6g %14s %9s  MISSING\n", b->name, b->value, "-", "-");
+            regressions++;
+            continue;
+        }
+        if (b->value == 0) {
+            continue;
+        }
+
+        // 悪化を正の割合で表す
+        double change = (c->value - b->value) / fabs(b->value) * 100;
+        double worse  = b->higher_is_better ? -change : change;
+        double noise  = 2 * sqrt(b->stddev * b->stddev + c->stddev * c->stddev) / fabs(b->value) * 100;
+        bool   regressed = (worse > threshold) && (worse > noise);
+
+        printf("%-32s %14.6g %14.6g %+8.2f%%%s\n", b->name, b->value, c->value, change,
+               regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+    }
+
+    return regressions;
+}
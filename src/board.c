@@ -56,6 +56,8 @@ struct Board_ {
     int  pattern[NUM_PATTERN_ID];                   ///< 盤面パターン状態
     int  pattern_id[NUM_DISK][NUM_PATTERN_DIFF];    ///< あるマスへの着手時に更新するパターンID
     int  pattern_diff[NUM_DISK][NUM_PATTERN_DIFF];  ///< あるマスへの着手時に更新するパターン状態の差分
+    uint64_t hash;                                  ///< 盤面のハッシュ値
+    uint64_t hash_key[NUM_DISK][2];                 ///< 各マスの石色に対応するハッシュ値 (Zobrist hashing)
 };
 
 ///
@@ -81,6 +83,10 @@ static int flip_line(Board *board, int color, int pos, int dir);
 static void add_pattern(Board *board, int id, const int *pos_list, int num);
 static void init_pattern_diff(Board *board);
 
+static void init_hash_key(Board *board);
+static void init_hash(Board *board);
+static void flip_hash(Board *board, int color, int pos, int count);
+
 static void flip_square_black(Board *board, int pos);
 static void flip_square_white(Board *board, int pos);
 static void put_square_black(Board *board, int pos);
@@ -96,6 +102,7 @@ Board *Board_create(void)
 
     if (board) {
         init_pattern_diff(board);
+        init_hash_key(board);
         Board_init(board);
     }
 
@@ -134,6 +141,62 @@ void Board_init(Board *board)
     board->disk_num[EMPTY] = (BOARD_SIZE * BOARD_SIZE) - 4;
 
     Board_init_pattern(board);
+    init_hash(board);
+}
+
+bool Board_set(Board *board, const char *str, int *color)
+{
+    int disks[BOARD_SIZE * BOARD_SIZE];
+    int num = 0;
+    int turn = BLACK;
+
+    for (const char *c = str; *c; c++) {
+        int disk;
+        if ((*c == 'X') || (*c == 'x') || (*c == '*')) {
+            disk = BLACK;
+        } else if ((*c == 'O') || (*c == 'o')) {
+            disk = WHITE;
+        } else if ((*c == '-') || (*c == '.')) {
+            disk = EMPTY;
+        } else if ((*c == ' ') || (*c == '/') || (*c == '\t') || (*c == '\n') || (*c == '\r')) {
+            continue;
+        } else {
+            return false;
+        }
+
+        if (num < (BOARD_SIZE * BOARD_SIZE)) {
+            disks[num++] = disk;
+        } else if ((num == (BOARD_SIZE * BOARD_SIZE)) && (disk != EMPTY)) {
+            // 65文字目は手番
+            turn = disk;
+            num++;
+        } else {
+            return false;
+        }
+    }
+
+    if (num < (BOARD_SIZE * BOARD_SIZE)) {
+        return false;
+    }
+
+    Board_init(board);
+
+    board->disk_num[BLACK] = 0;
+    board->disk_num[WHITE] = 0;
+    board->disk_num[EMPTY] = 0;
+    for (int i = 0; i < (BOARD_SIZE * BOARD_SIZE); i++) {
+        board->disks[Board_pos(i % BOARD_SIZE, i / BOARD_SIZE)] = disks[i];
+        board->disk_num[disks[i]]++;
+    }
+
+    Board_init_pattern(board);
+    init_hash(board);
+
+    if (color) {
+        *color = turn;
+    }
+
+    return true;
 }
 
 int Board_disk(const Board *board, int pos)
@@ -180,7 +243,7 @@ static int flip_line(Board *board, int color, int pos, int dir)
                     cur_pos += dir;
                     if (board->disks[cur_pos] == op) {
                         cur_pos += dir;
-                        if (board->disks[cur_pos] == op) {
+                        if (board->disks[cur_pos] != color) {
                             return 0;
                         }
                         // 端が同色石のとき反転、スタックへ記録
@@ -339,6 +402,7 @@ int Board_flip(Board *board, int color, int pos)
 
     if (count > 0) {
         board->disks[pos] = color;
+        flip_hash(board, color, pos, count);
         // スタックへ記録
         STACK_PUSH(board, pos);
         STACK_PUSH(board, Board_opponent(color));
@@ -360,8 +424,10 @@ int Board_unflip(Board *board)
 
     int count = STACK_POP(board);
     int color = STACK_POP(board);
+    int pos   = STACK_POP(board);
 
-    board->disks[STACK_POP(board)] = EMPTY;
+    board->disks[pos] = EMPTY;
+    flip_hash(board, Board_opponent(color), pos, count);
 
     for (int i = 0; i < count; i++) {
         board->disks[STACK_POP(board)] = color;
@@ -394,6 +460,102 @@ int Board_pattern(const Board *board, int id)
     return board->pattern[id];
 }
 
+const int *Board_pattern_list(const Board *board)
+{
+    return board->pattern;
+}
+
+uint64_t Board_hash(const Board *board)
+{
+    return board->hash;
+}
+
+uint64_t Board_canonical_hash(const Board *board)
+{
+    uint64_t hash[8] = { 0 };
+
+    // 対称変換: bit0 左右反転、bit1 上下反転、bit2 対角線反転
+    for (int y = 0; y < BOARD_SIZE; y++) {
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            int disk = board->disks[Board_pos(x, y)];
+            if (disk == EMPTY) {
+                continue;
+            }
+            for (int sym = 0; sym < 8; sym++) {
+                int tx = (sym & 1) ? ((BOARD_SIZE - 1) - x) : x;
+                int ty = (sym & 2) ? ((BOARD_SIZE - 1) - y) : y;
+                int pos = (sym & 4) ? Board_pos(ty, tx) : Board_pos(tx, ty);
+                hash[sym] ^= board->hash_key[pos][disk];
+            }
+        }
+    }
+
+    uint64_t min = hash[0];
+    for (int sym = 1; sym < 8; sym++) {
+        if (hash[sym] < min) {
+            min = hash[sym];
+        }
+    }
+
+    return min;
+}
+
+///
+/// @fn     init_hash_key
+/// @brief  各マスのハッシュ値を初期化する
+/// @param[in,out]  board   盤面
+/// @note   盤面間で同じ値となるよう固定シードの疑似乱数 (SplitMix64) で生成する
+///
+static void init_hash_key(Board *board)
+{
+    uint64_t x = 0;
+
+    for (int i = 0; i < NUM_DISK; i++) {
+        for (int j = 0; j < 2; j++) {
+            uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            board->hash_key[i][j] = z ^ (z >> 31);
+        }
+    }
+}
+
+///
+/// @fn     init_hash
+/// @brief  盤面のハッシュ値を計算する
+/// @param[in,out]  board   盤面
+///
+static void init_hash(Board *board)
+{
+    board->hash = 0;
+
+    for (int i = 0; i < NUM_DISK; i++) {
+        if ((board->disks[i] == BLACK) || (board->disks[i] == WHITE)) {
+            board->hash ^= board->hash_key[i][board->disks[i]];
+        }
+    }
+}
+
+///
+/// @fn     flip_hash
+/// @brief  着手によるハッシュ値の差分を反映する
+/// @param[in,out]  board   盤面
+/// @param[in]      color   着手した石色
+/// @param[in]      pos     着手座標
+/// @param[in]      count   返した石数
+/// @note   返した石はスタック先頭のcount個から取得する（着手・戻しで同じ差分となる）
+///
+static void flip_hash(Board *board, int color, int pos, int count)
+{
+    uint64_t hash = board->hash ^ board->hash_key[pos][color];
+
+    for (int *p = (board->sp - count); p < board->sp; p++) {
+        hash ^= board->hash_key[*p][BLACK] ^ board->hash_key[*p][WHITE];
+    }
+
+    board->hash = hash;
+}
+
 ///
 /// @fn     add_pattern
 /// @brief  指定パターンの状態を登録する
@@ -425,50 +587,11 @@ static void add_pattern(Board *board, int id, const int *pos_list, int num)
 static void init_pattern_diff(Board *board)
 {
     int i, j;
-    // 各パターンの使用マス
-    int pattern_list[][9] = {
-        { A4, B4, C4, D4, E4, F4, G4, H4, -1 },
-        { A5, B5, C5, D5, E5, F5, G5, H5, -1 },
-        { D1, D2, D3, D4, D5, D6, D7, D8, -1 },
-        { E1, E2, E3, E4, E5, E6, E7, E8, -1 },
-        { A3, B3, C3, D3, E3, F3, G3, H3, -1 },
-        { A6, B6, C6, D6, E6, F6, G6, H6, -1 },
-        { C1, C2, C3, C4, C5, C6, C7, C8, -1 },
-        { F1, F2, F3, F4, F5, F6, F7, F8, -1 },
-        { A2, B2, C2, D2, E2, F2, G2, H2, -1 },
-        { A7, B7, C7, D7, E7, F7, G7, H7, -1 },
-        { B1, B2, B3, B4, B5, B6, B7, B8, -1 },
-        { G1, G2, G3, G4, G5, G6, G7, G8, -1 },
-        { A1, B2, C3, D4, E5, F6, G7, H8, -1 },
-        { A8, B7, C6, D5, E4, F3, G2, H1, -1 },
-        { A2, B3, C4, D5, E6, F7, G8, -1 },
-        { B1, C2, D3, E4, F5, G6, H7, -1 },
-        { A7, B6, C5, D4, E3, F2, G1, -1 },
-        { B8, C7, D6, E5, F4, G3, H2, -1 },
-        { A3, B4, C5, D6, E7, F8, -1 },
-        { C1, D2, E3, F4, G5, H6, -1 },
-        { A6, B5, C4, D3, E2, F1, -1 },
-        { C8, D7, E6, F5, G4, H3, -1 },
-        { A4, B5, C6, D7, E8, -1 },
-        { D1, E2, F3, G4, H5, -1 },
-        { A5, B4, C3, D2, E1, -1 },
-        { D8, E7, F6, G5, H4, -1 },
-        { A5, B6, C7, D8, -1 },
-        { E1, F2, G3, H4, -1 },
-        { A4, B3, C2, D1, -1 },
-        { E8, F7, G6, H5, -1 },
-        { B2, G1, F1, E1, D1, C1, B1, A1, -1 },
-        { G2, B1, C1, D1, E1, F1, G1, H1, -1 },
-        { B7, G8, F8, E8, D8, C8, B8, A8, -1 },
-        { G7, B8, C8, D8, E8, F8, G8, H8, -1 },
-        { B2, A7, A6, A5, A4, A3, A2, A1, -1 },
-        { B7, A2, A3, A4, A5, A6, A7, A8, -1 },
-        { G2, H7, H6, H5, H4, H3, H2, H1, -1 },
-        { G7, H2, H3, H4, H5, H6, H7, H8, -1 },
-        { B3, A3, C2, B2, A2, C1, B1, A1, -1 },
-        { G3, H3, F2, G2, H2, F1, G1, H1, -1 },
-        { B6, A6, C7, B7, A7, C8, B8, A8, -1 },
-        { G6, H6, F7, G7, H7, F8, G8, H8, -1 },
+    // 各パターンの使用マス: pattern.hの定義から生成する
+    static const int pattern_list[][MAX_PATTERN_SQUARES + 1] = {
+#define PATTERN_SQUARES(name, type, ...) { __VA_ARGS__, -1 },
+        PATTERN_ID_LIST(PATTERN_SQUARES)
+#undef PATTERN_SQUARES
         { -1 }
     };
 
@@ -630,7 +753,7 @@ static int flip_line_pattern(Board *board, int color, int pos, int dir)
                     cur_pos += dir;
                     if (board->disks[cur_pos] == op) {
                         cur_pos += dir;
-                        if (board->disks[cur_pos] == op) {
+                        if (board->disks[cur_pos] != color) {
                             return 0;
                         }
                         cur_pos -= dir;
@@ -791,6 +914,7 @@ int Board_flip_pattern(Board *board, int color, int pos)
         } else {
             put_square_white(board, pos);
         }
+        flip_hash(board, color, pos, count);
         STACK_PUSH(board, pos);
         STACK_PUSH(board, Board_opponent(color));
         STACK_PUSH(board, count);
@@ -811,14 +935,17 @@ int Board_unflip_pattern(Board *board)
 
     int count  = STACK_POP(board);
     int color = STACK_POP(board);
+    int pos   = STACK_POP(board);
+
+    flip_hash(board, Board_opponent(color), pos, count);
 
     if (color == BLACK) {
-        remove_square_white(board, STACK_POP(board));
+        remove_square_white(board, pos);
         for (int i = 0; i < count; i++) {
             flip_square_black(board, STACK_POP(board));
         }
     } else {
-        remove_square_black(board, STACK_POP(board));
+        remove_square_black(board, pos);
         for (int i = 0; i < count; i++) {
             flip_square_white(board, STACK_POP(board));
         }
@@ -1019,6 +1146,7 @@ void Board_reverse(Board *board)
     }
 
     Board_init_pattern(board);
+    init_hash(board);
 }
 
 bool Board_can_play(const Board *board, int color)
@@ -1035,6 +1163,21 @@ bool Board_can_play(const Board *board, int color)
     return false;
 }
 
+uint64_t Board_legal_moves(const Board *board, int color)
+{
+    uint64_t moves = 0;
+
+    for (int y = 0; y < BOARD_SIZE; y++) {
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            if (Board_can_flip(board, color, Board_pos(x, y))) {
+                moves |= 1ULL << (y * BOARD_SIZE + x);
+            }
+        }
+    }
+
+    return moves;
+}
+
 int Board_pos(int x, int y)
 {
     return ((y + 1) * (BOARD_SIZE + 1) + (x + 1));
@@ -5,10 +5,13 @@
 ///
 
 #include "com.h"
+#include "evalcache.h"
+#include "endcache.h"
+#include "trace.h"
 
 #include <stdlib.h>
 #include <string.h>
-#include <limits.h>
+#include <time.h>
 
 ///
 /// @def    MAX_VALUE
@@ -16,6 +19,42 @@
 ///
 #define MAX_VALUE (DISK_VALUE * 200)
 
+///
+/// @def    MIN_ENDCACHE_EMPTIES
+/// @brief  終盤キャッシュを使う最小の空きマス数
+/// @note   これより浅い局面は探索し直すほうが速い
+///
+#define MIN_ENDCACHE_EMPTIES 6
+
+///
+/// @def    WHITE_HASH_KEY
+/// @brief  白手番の局面のハッシュ値に加えるキー
+/// @note   盤面のハッシュ値は手番を含まないため、終盤キャッシュで手番を区別する
+///
+#define WHITE_HASH_KEY 0x5DEECE66DF00D7A1ULL
+
+///
+/// @def    BUDGET_CHECK_NODES
+/// @brief  探索の予算（時間）を確認するノード数の間隔
+///
+#define BUDGET_CHECK_NODES 1024
+
+///
+/// @def    STATS
+/// @brief  COM_STATSが有効なときのみ統計を集計する文
+///
+#if COM_STATS
+#define STATS(statement) statement
+#else
+#define STATS(statement)
+#endif
+
+///
+/// @def    PLY_INDEX
+/// @brief  手数ごとの局面数の添字（最大の手数を超えたら最後の要素にまとめる）
+///
+#define PLY_INDEX(ply) (((ply) < COM_STATS_PLY) ? (ply) : (COM_STATS_PLY - 1))
+
 ///
 /// @struct MoveList
 /// @brief  候補手リスト
@@ -46,7 +85,30 @@ struct Com_ {
     int         mid_depth;      ///< 中盤探索深さ
     int         wld_depth;      ///< 必勝読み深さ
     int         exact_depth;    ///< 完全読み深さ
-    int         node;           ///< 探索したノード数
+    uint64_t    node;           ///< 探索したノード数
+    ComStats    stats;          ///< 探索の統計
+    int         search_depth;   ///< 中盤探索の深さ
+    EvalCache   *cache;         ///< 評価値キャッシュ
+    int         cache_size;     ///< 評価値キャッシュのエントリ数
+    int         cache_version;  ///< キャッシュ内容の評価値の版数
+    unsigned long long cache_hit;   ///< 評価値キャッシュのヒット数
+    unsigned long long cache_miss;  ///< 評価値キャッシュのミス数
+    EndCache    *endcache;      ///< 終盤キャッシュ（共有）
+    int         endcache_empties;   ///< 終盤キャッシュを使う最大の空きマス数
+    int         root_empties;   ///< 探索開始局面の空きマス数
+    int         node_budget;    ///< 1手あたりの探索ノード数の上限（0で無制限）
+    double      time_budget;    ///< 1手あたりの探索時間[s]の上限（0で無制限）
+    uint64_t    node_check;     ///< 次に予算を確認するノード数
+    double      deadline;       ///< 探索を打ち切る時刻[s]
+    bool        aborted;        ///< 予算を超えて探索を打ち切ったか
+    int         ply;            ///< 探索開始局面からの手数
+    int         pv[COM_MAX_PLY][COM_MAX_PLY];   ///< 手数ごとの最善手順（三角配列）
+    int         pv_length[COM_MAX_PLY];         ///< 手数ごとの最善手順の終端
+    int         best_pv[COM_MAX_PLY];   ///< 直前に探索し終えた最善手順
+    int         best_pv_length;         ///< 直前に探索し終えた最善手順の長さ
+    bool        follow_pv;      ///< 直前の最善手順上の局面を探索しているか
+    FILE        *report;        ///< 反復ごとの探索結果の出力先（NULLで出力しない）
+    double      search_start;   ///< 1手の探索の開始時刻[s]
     MoveList    moves[BOARD_SIZE * BOARD_SIZE]; ///< 候補手リスト
 };
 
@@ -55,7 +117,24 @@ static bool initialize(Com *com, Evaluator *eval);
 static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool pass, int alpha, int beta, int depth);
 static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool pass, int alpha, int beta, int depth);
 
-static void make_move_list(Com *com);
+static int evaluate(Com *com);
+
+static int prepare(Com *com, const Board *board, double start);
+static void finish(Com *com, double start);
+static int analyze_root(Com *com, int turn, int depth, bool end, int k, ComResult *results);
+
+static double now(void);
+static void start_budget(Com *com);
+static bool check_budget(Com *com);
+static int search_mid(Com *com, int color, int depth, int *next_move);
+static int search_end(Com *com, int color, int beta, int depth, int *next_move);
+static int search_iterative(Com *com, int color, int *next_move);
+
+static void update_pv(Com *com, int move);
+static void save_pv(Com *com);
+static void order_pv(Com *com, MoveInfo *moveinfo, int num);
+static void report(Com *com, const char *type, int depth, int value);
+
 static void make_move_list(Com *com);
 static void remove_list(MoveList *movelist);
 static void recover_list(MoveList *movelist);
@@ -105,12 +184,33 @@ Com *Com_create(Evaluator *eval)
     return com;
 }
 
+Com *Com_clone(const Com *com)
+{
+    Com *clone = Com_create(com->evaluator);
+
+    if (clone) {
+        Com_set_level(clone, com->mid_depth, com->exact_depth, com->wld_depth);
+        Com_set_endcache(clone, com->endcache, com->endcache_empties);
+        Com_set_budget(clone, com->node_budget, com->time_budget);
+        if (!Com_set_cache(clone, com->cache_size)) {
+            Com_delete(clone);
+            clone = NULL;
+        }
+    }
+
+    return clone;
+}
+
 void Com_delete(Com *com)
 {
     if (com->board) {
         Board_delete(com->board);
     }
 
+    if (com->cache) {
+        EvalCache_delete(com->cache);
+    }
+
     free(com);
     com = NULL;
 }
@@ -122,49 +222,509 @@ void Com_set_level(Com *com, int mid_depth, int th_exact, int th_wld)
     com->wld_depth   = th_wld;
 }
 
+void Com_set_report(Com *com, FILE *fp)
+{
+    com->report = fp;
+}
+
+void Com_set_budget(Com *com, int nodes, double seconds)
+{
+    com->node_budget = (nodes > 0) ? nodes : 0;
+    com->time_budget = (seconds > 0) ? seconds : 0;
+}
+
+bool Com_set_cache(Com *com, int size)
+{
+    if (com->cache) {
+        EvalCache_delete(com->cache);
+        com->cache = NULL;
+    }
+
+    com->cache_size = size;
+    if (size > 0) {
+        com->cache = EvalCache_create(size);
+        if (!com->cache) {
+            return false;
+        }
+        com->cache_version = Evaluator_version(com->evaluator);
+    }
+
+    return true;
+}
+
+void Com_set_endcache(Com *com, EndCache *cache, int empties)
+{
+    com->endcache         = cache;
+    com->endcache_empties = empties;
+}
+
 int Com_get_nextmove(Com *com, Board *board, int color, int *value)
+{
+    double start = now();
+
+    TRACE_BEGIN("Com_get_nextmove", Board_count_disks(board, EMPTY));
+
+    int left = prepare(com, board, start);
+
+    int next_move;
+    int val;
+
+    start_budget(com);
+
+    if ((left <= com->exact_depth) || (left <= com->wld_depth)) {
+        // 完全読み、または必勝読み（勝敗のみ求めるため探索範囲の上限を1とする）
+        int beta = (left <= com->exact_depth) ? (BOARD_SIZE * BOARD_SIZE) : 1;
+
+        if ((com->node_budget > 0) || (com->time_budget > 0)) {
+            // 予算があるときは中盤探索の深さまで先に反復深化し、残りの予算で読み切れたときのみ終盤探索の結果を使う
+            val = search_iterative(com, color, &next_move);
+            if (!com->aborted) {
+                int move;
+                int v = search_end(com, color, beta, left, &move);
+                if (!com->aborted) {
+                    val       = v;
+                    next_move = move;
+                }
+            }
+            com->aborted = false;
+        } else {
+            val = search_end(com, color, beta, left, &next_move);
+        }
+    } else if ((com->node_budget > 0) || (com->time_budget > 0) || com->report) {
+        // 予算のある・結果を出力する中盤探索
+        val = search_iterative(com, color, &next_move);
+        com->aborted = false;
+    } else {
+        val = search_mid(com, color, com->mid_depth, &next_move);
+    }
+
+    finish(com, start);
+
+    TRACE_END();
+
+    if (value) {
+        *value = val;
+    }
+
+    return next_move;
+}
+
+int Com_analyze(Com *com, const Board *board, int color, int k, ComResult *results)
+{
+    double start = now();
+
+    TRACE_BEGIN("Com_analyze", Board_count_disks(board, EMPTY));
+
+    int left = prepare(com, board, start);
+    int num;
+
+    // 予算は1手を選ぶ探索のためのもので、解析では打ち切らない
+    com->aborted    = false;
+    com->node_check = UINT64_MAX;
+
+    if (left <= com->exact_depth) {
+        num = analyze_root(com, color, left, true, k, results);
+        com->stats.end_nodes += com->node;
+    } else {
+        int col   = color;
+        int depth = com->mid_depth;
+
+        // search_midと同じく、盤面を反転し黒手番で評価する
+        if (((color == WHITE) && (depth % 2 == 0)) ||
+            ((color == BLACK) && (depth % 2 == 1))) {
+            Board_reverse(com->board);
+            col = Board_opponent(color);
+        }
+        com->search_depth = depth;
+        num = analyze_root(com, col, depth, false, k, results);
+        com->stats.mid_nodes += com->node;
+        if (col != color) {
+            Board_reverse(com->board);
+        }
+    }
+
+    finish(com, start);
+
+    TRACE_END();
+
+    return num;
+}
+
+///
+/// @fn     prepare
+/// @brief  探索開始局面を設定する
+/// @param[in,out]  com     COM
+/// @param[in]      board   盤面
+/// @param[in]      start   探索の開始時刻[s]
+/// @return 空きマス数
+/// @note   盤面の複製・候補手リストの作成・パターンの初期化をし、計数を0に戻す
+///
+static int prepare(Com *com, const Board *board, double start)
 {
     Board_copy(board, com->board);
     com->node = 0;
+    com->cache_hit  = 0;
+    com->cache_miss = 0;
+
+    // 評価値が更新されていればキャッシュを破棄する
+    if (com->cache && (com->cache_version != Evaluator_version(com->evaluator))) {
+        EvalCache_clear(com->cache);
+        com->cache_version = Evaluator_version(com->evaluator);
+    }
 
     int left = Board_count_disks(com->board, EMPTY);
+    com->root_empties   = left;
+    com->best_pv_length = 0;
+    com->search_start   = start;
 
     make_move_list(com);
 
     Board_init_pattern(com->board);
 
-    int next_move;
-    int col;
-    int val;
+    return left;
+}
 
-    if (left <= com->exact_depth) {
-        // 完全読み
-        val = Com_end_search(com, color, Board_opponent(color), &next_move, false, -(BOARD_SIZE * BOARD_SIZE), (BOARD_SIZE * BOARD_SIZE), left);
-        val *= DISK_VALUE;
-    } else if (left <= com->wld_depth) {
-        // 必勝読み
-        val = Com_end_search(com, color, Board_opponent(color), &next_move, false, -(BOARD_SIZE * BOARD_SIZE), 1, left);
-        val *= DISK_VALUE;
+///
+/// @fn     finish
+/// @brief  1手の探索の計数を統計へ加える
+/// @param[in,out]  com     COM
+/// @param[in]      start   探索の開始時刻[s]
+///
+static void finish(Com *com, double start)
+{
+    com->stats.moves++;
+    com->stats.nodes        += com->node;
+    com->stats.cache_probes += com->cache_hit + com->cache_miss;
+    com->stats.cache_hits   += com->cache_hit;
+    com->stats.time         += now() - start;
+}
+
+///
+/// @fn     analyze_root
+/// @brief  探索開始局面の有効手のうち、評価値の高いk手とその評価値を求める
+/// @param[in,out]  com     COM
+/// @param[in]      turn    手番色
+/// @param[in]      depth   探索深さ（終盤探索は空きマス数）
+/// @param[in]      end     終盤探索（完全読み）するか
+/// @param[in]      k       求める手数
+/// @param[out]     results 評価値の高い順の着手と評価値
+/// @return 求めた手数
+/// @note   k手そろうまでは全範囲、以降はk番目の評価値を下限として探索し、
+///         下限を超えた手のみ正確な評価値で入れ替える
+///
+static int analyze_root(Com *com, int turn, int depth, bool end, int k, ComResult *results)
+{
+    int opponent = Board_opponent(turn);
+    int lower    = end ? -(BOARD_SIZE * BOARD_SIZE) : -MAX_VALUE;
+    int upper    = end ?  (BOARD_SIZE * BOARD_SIZE) :  MAX_VALUE;
+    int num = 0;
+    int move;
+    MoveInfo info[BOARD_SIZE * BOARD_SIZE / 2];
+
+    if (k <= 0) {
+        return 0;
+    }
+
+    // 1手読みの評価値の高い順に調べ、下限を早く上げる
+    int info_num = sort_moves(com, turn, info);
+
+    for (int i = 0; i < info_num; i++) {
+        int alpha = (num < k) ? lower : results[k - 1].value;
+        int value;
+
+        Board_flip_pattern(com->board, turn, info[i].move->pos);
+        remove_list(info[i].move);
+
+        com->ply       = 1;
+        com->follow_pv = false;
+        if (end) {
+            value = -Com_end_search(com, opponent, turn, &move, false, -upper, -alpha, (depth - 1));
+        } else {
+            value = -Com_mid_search(com, opponent, turn, &move, false, -upper, -alpha, (depth - 1));
+        }
+
+        Board_unflip_pattern(com->board);
+        recover_list(info[i].move);
+
+        // 下限以下の手はk手に入らない
+        if ((num >= k) && (value <= alpha)) {
+            continue;
+        }
+
+        // 評価値の高い順に挿入する
+        int j = (num < k) ? num++ : (k - 1);
+        for (; (j > 0) && (results[j - 1].value < value); j--) {
+            results[j] = results[j - 1];
+        }
+        results[j].move  = info[i].move->pos;
+        results[j].value = value;
+    }
+
+    if (end) {
+        for (int i = 0; i < num; i++) {
+            results[i].value *= DISK_VALUE;
+        }
+    }
+
+    return num;
+}
+
+///
+/// @fn     now
+/// @brief  探索時間の計測用の時刻を取得する
+/// @return 時刻[s]
+///
+static double now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+/// @fn     start_budget
+/// @brief  1手の探索の予算を設定する
+/// @param[in,out]  com     COM
+///
+static void start_budget(Com *com)
+{
+    com->aborted = false;
+
+    if (com->time_budget > 0) {
+        com->deadline   = now() + com->time_budget;
+        com->node_check = BUDGET_CHECK_NODES;
+    } else if (com->node_budget > 0) {
+        com->node_check = com->node_budget;
     } else {
-        // 中盤探索
-        // 盤面を反転し黒手番で評価する
-        if (((color == WHITE) && (com->mid_depth % 2 == 0)) ||
-            ((color == BLACK) && (com->mid_depth % 2 == 1))) {
-            Board_reverse(com->board);
-            col = Board_opponent(color);
+        // 予算なし: 確認しない
+        com->node_check = UINT64_MAX;
+    }
+}
+
+///
+/// @fn     check_budget
+/// @brief  探索の予算を超えたか確認する
+/// @param[in,out]  com     COM
+/// @retval true    予算を超えた（以降の探索は打ち切る）
+/// @retval false   予算内
+/// @note   探索ノード数が確認点に達したときのみ呼ばれ、次の確認点を設定する
+///
+static bool check_budget(Com *com)
+{
+    if (!com->aborted) {
+        if (((com->node_budget > 0) && (com->node >= (uint64_t)com->node_budget)) ||
+            ((com->time_budget > 0) && (now() >= com->deadline))) {
+            com->aborted = true;
         } else {
-            col = color;
+            com->node_check = com->node + BUDGET_CHECK_NODES;
+            if ((com->node_budget > 0) && (com->node_check > (uint64_t)com->node_budget)) {
+                com->node_check = com->node_budget;
+            }
         }
+    }
 
-        // 探索範囲を -MAX_VALUE - MAX_VALUE とする
-        val = Com_mid_search(com, col, Board_opponent(col), &next_move, false, -MAX_VALUE, MAX_VALUE, com->mid_depth);
+    if (com->aborted) {
+        // 以降はすべてのノードで打ち切る
+        com->node_check = 0;
     }
 
-    if (value) {
-        *value = val;
+    return com->aborted;
+}
+
+///
+/// @fn     search_mid
+/// @brief  中盤探索する
+/// @param[in,out]  com         COM
+/// @param[in]      color       手番色
+/// @param[in]      depth       探索深さ
+/// @param[out]     next_move   最善手
+/// @return 評価値
+///
+static int search_mid(Com *com, int color, int depth, int *next_move)
+{
+    int col = color;
+
+    // 盤面を反転し黒手番で評価する
+    if (((color == WHITE) && (depth % 2 == 0)) ||
+        ((color == BLACK) && (depth % 2 == 1))) {
+        Board_reverse(com->board);
+        col = Board_opponent(color);
     }
 
-    return next_move;
+    uint64_t node = com->node;
+    com->search_depth = depth;
+    com->ply          = 0;
+    com->follow_pv    = (com->best_pv_length > 0);
+
+    // 探索範囲を -MAX_VALUE - MAX_VALUE とする
+    TRACE_BEGIN("search_mid", depth);
+    int val = Com_mid_search(com, col, Board_opponent(col), next_move, false, -MAX_VALUE, MAX_VALUE, depth);
+    TRACE_END();
+    com->stats.mid_nodes += com->node - node;
+
+    if (col != color) {
+        Board_reverse(com->board);
+    }
+
+    if (!com->aborted) {
+        save_pv(com);
+        report(com, "mid", depth, val);
+    }
+
+    return val;
+}
+
+///
+/// @fn     search_end
+/// @brief  終盤探索（完全読み・必勝読み）する
+/// @param[in,out]  com         COM
+/// @param[in]      color       手番色
+/// @param[in]      beta        探索上限（完全読みは盤面のマス数、必勝読みは1）
+/// @param[in]      depth       空きマス数
+/// @param[out]     next_move   最善手
+/// @return 評価値（石数差 * DISK_VALUE）
+///
+static int search_end(Com *com, int color, int beta, int depth, int *next_move)
+{
+    uint64_t node = com->node;
+    com->ply       = 0;
+    com->follow_pv = false;
+
+    TRACE_BEGIN("end_search", depth);
+    int val = Com_end_search(com, color, Board_opponent(color), next_move, false, -(BOARD_SIZE * BOARD_SIZE), beta, depth);
+    TRACE_END();
+    val *= DISK_VALUE;
+    com->stats.end_nodes += com->node - node;
+
+    if (!com->aborted) {
+        save_pv(com);
+        report(com, ((beta == 1) ? "wld" : "exact"), depth, val);
+    }
+
+    return val;
+}
+
+///
+/// @fn     search_iterative
+/// @brief  中盤探索を1手読みから設定した深さまで反復深化する
+/// @param[in,out]  com         COM
+/// @param[in]      color       手番色
+/// @param[out]     next_move   最善手
+/// @return 評価値
+/// @note   直前の深さの最善手順から調べ、打ち切られたときは直前の深さの結果を返す
+///         1手読みは打ち切らない。打ち切られたかはcom->abortedに残す
+///
+static int search_iterative(Com *com, int color, int *next_move)
+{
+    uint64_t node_check = com->node_check;
+    com->node_check = UINT64_MAX;
+    int val = search_mid(com, color, 1, next_move);
+    com->node_check = node_check;
+
+    for (int depth = 2; !com->aborted && (depth <= com->mid_depth); depth++) {
+        int move;
+        int v = search_mid(com, color, depth, &move);
+        if (!com->aborted) {
+            val        = v;
+            *next_move = move;
+        }
+    }
+
+    return val;
+}
+
+///
+/// @fn     update_pv
+/// @brief  現在の手数の最善手順を、着手と子局面の最善手順で更新する
+/// @param[in,out]  com     COM
+/// @param[in]      move    着手（パスはNONE）
+/// @note   子局面の探索の直後に呼ぶ
+///
+static void update_pv(Com *com, int move)
+{
+    int ply = com->ply;
+    if ((ply + 1) >= COM_MAX_PLY) {
+        return;
+    }
+
+    com->pv[ply][ply] = move;
+    int length = com->pv_length[ply + 1];
+    for (int i = (ply + 1); i < length; i++) {
+        com->pv[ply][i] = com->pv[ply + 1][i];
+    }
+    com->pv_length[ply] = (length > (ply + 1)) ? length : (ply + 1);
+}
+
+///
+/// @fn     save_pv
+/// @brief  探索し終えた最善手順を保存する
+/// @param[in,out]  com     COM
+/// @note   保存した手順は次の反復の着手順に使う
+///
+static void save_pv(Com *com)
+{
+    com->best_pv_length = com->pv_length[0];
+    for (int i = 0; i < com->best_pv_length; i++) {
+        com->best_pv[i] = com->pv[0][i];
+    }
+}
+
+///
+/// @fn     order_pv
+/// @brief  直前の最善手順上の局面では、最善手順の着手を先頭へ移す
+/// @param[in,out]  com         COM
+/// @param[in,out]  moveinfo    並び替えた着手情報
+/// @param[in]      num         着手数
+///
+static void order_pv(Com *com, MoveInfo *moveinfo, int num)
+{
+    if (!com->follow_pv || (com->ply >= com->best_pv_length)) {
+        com->follow_pv = false;
+        return;
+    }
+
+    int pv_move = com->best_pv[com->ply];
+    for (int i = 0; i < num; i++) {
+        if (moveinfo[i].move->pos == pv_move) {
+            MoveInfo tmp = moveinfo[i];
+            for (int j = i; j > 0; j--) {
+                moveinfo[j] = moveinfo[j - 1];
+            }
+            moveinfo[0] = tmp;
+            return;
+        }
+    }
+
+    com->follow_pv = false;
+}
+
+///
+/// @fn     report
+/// @brief  探索結果（深さ・評価値・ノード数・毎秒のノード数・最善手順）を出力する
+/// @param[in]  com     COM
+/// @param[in]  type    探索の種類
+/// @param[in]  depth   探索深さ
+/// @param[in]  value   評価値
+///
+static void report(Com *com, const char *type, int depth, int value)
+{
+    if (!com->report) {
+        return;
+    }
+
+    double time = now() - com->search_start;
+    fprintf(com->report, "%-5s depth %2d score %+7.2f nodes %10llu nps %10.0f pv",
+            type, depth, (double)value / DISK_VALUE, (unsigned long long)com->node,
+            ((time > 0) ? (com->node / time) : 0.0));
+    for (int i = 0; i < com->best_pv_length; i++) {
+        if (com->best_pv[i] == NONE) {
+            fprintf(com->report, " --");
+        } else {
+            fprintf(com->report, " %c%c", POS2COL(com->best_pv[i]), POS2ROW(com->best_pv[i]));
+        }
+    }
+    fprintf(com->report, "\n");
 }
 
 ///
@@ -183,10 +743,23 @@ int Com_get_nextmove(Com *com, Board *board, int color, int *value)
 ///
 static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool pass, int alpha, int beta, int depth)
 {
+    STATS(com->stats.ply_nodes[PLY_INDEX(com->search_depth - depth)]++);
+
+    if (com->ply < COM_MAX_PLY) {
+        com->pv_length[com->ply] = com->ply;
+    }
+
+    // 予算を超えたら打ち切る（返す値は使われない）
+    if ((com->node >= com->node_check) && check_budget(com)) {
+        *next_move = NONE;
+        return alpha;
+    }
+
     // 探索末端（リーフ）: 盤面の評価値を返す
     if (depth == 0) {
         com->node++;
-        return Evaluator_evaluate(com->evaluator, com->board);
+        STATS(com->stats.evaluations++);
+        return evaluate(com);
     }
 
     int move;
@@ -202,7 +775,10 @@ static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool
 
     if (depth > 2) {
         // 残り手数が2より多いとき候補手を並び替える
+        // 直前の反復の最善手順上では、その着手を先に調べる
         info_num = sort_moves(com, turn, info);
+        order_pv(com, info, info_num);
+        bool on_pv = com->follow_pv;
 
         if (info_num > 0) {
             *next_move = info[0].move->pos;
@@ -213,20 +789,31 @@ static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool
             Board_flip_pattern(com->board, turn, info[i].move->pos);
             remove_list(info[i].move);
 
+            com->follow_pv = on_pv && (i == 0);
+            com->ply++;
             value = -Com_mid_search(com, opponent, turn, &move, false, -beta, -max, (depth - 1));
+            com->ply--;
 
             Board_unflip_pattern(com->board);
             recover_list(info[i].move);
 
+            if (com->aborted) {
+                return max;
+            }
+
             if (value > max) {
                 max = value;
                 *next_move = info[i].move->pos;
+                update_pv(com, *next_move);
                 if (max >= beta) {
+                    STATS(com->stats.cutoffs++; com->stats.first_cutoffs += (i == 0));
                     return beta;
                 }
             }
         }
     } else {
+        STATS(int tried = 0);
+
         // 候補手リストを探索する
         for (p = com->moves->next; p; (p = p->next)) {
             // 着手できるとき着手する
@@ -238,21 +825,31 @@ static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool
                 }
 
                 // 子ノードを探索
+                com->follow_pv = false;
+                com->ply++;
                 value = -Com_mid_search(com, opponent, turn, &move, false, -beta, -max, (depth - 1));
+                com->ply--;
 
                 // 盤面・候補手リストを戻す
                 Board_unflip_pattern(com->board);
                 recover_list(p);
 
+                if (com->aborted) {
+                    return max;
+                }
+
                 // alphaカット: 下限値での枝刈り
                 if (value > max) {
                     max = value;
                     *next_move = p->pos;
+                    update_pv(com, *next_move);
                     // betaカット: 上限値での枝刈り
                     if (max >= beta) {
+                        STATS(com->stats.cutoffs++; com->stats.first_cutoffs += (tried == 0));
                         return beta;
                     }
                 }
+                STATS(tried++);
             }
         }
     }
@@ -266,7 +863,10 @@ static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool
         } else {
             // 相手に有効手あるときパス、手番を変更して探索続ける
             *next_move = NONE;
+            com->ply++;
             max = -Com_mid_search(com, opponent, turn, &move, true, -beta, -max, (depth - 1));
+            com->ply--;
+            update_pv(com, NONE);
         }
     }
 
@@ -288,6 +888,12 @@ static int Com_mid_search(Com *com, int turn, int opponent, int *next_move, bool
 ///
 static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool pass, int alpha, int beta, int depth)
 {
+    STATS(com->stats.ply_nodes[PLY_INDEX(com->root_empties - depth)]++);
+
+    if (com->ply < COM_MAX_PLY) {
+        com->pv_length[com->ply] = com->ply;
+    }
+
     // リーフ: 盤面評価値を返す
     if (depth == 0) {
         com->node++;
@@ -314,6 +920,10 @@ static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool
         value = Board_count_flips(com->board, turn, p->pos);
         if (value > 0) {
             *next_move = p->pos;
+            if (com->ply < COM_MAX_PLY) {
+                com->pv[com->ply][com->ply] = p->pos;
+                com->pv_length[com->ply]    = com->ply + 1;
+            }
             return (max + value + value + 1);
         }
 
@@ -321,6 +931,12 @@ static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool
         value = Board_count_flips(com->board, opponent, com->moves->next->pos);
         if (value > 0) {
             *next_move = NONE;
+            // パスして相手が着手する
+            if ((com->ply + 2) <= COM_MAX_PLY) {
+                com->pv[com->ply][com->ply]     = NONE;
+                com->pv[com->ply][com->ply + 1] = p->pos;
+                com->pv_length[com->ply]        = com->ply + 2;
+            }
             return (max - value - value - 1);
         }
 
@@ -331,9 +947,39 @@ static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool
 
     *next_move = NONE;
 
+    // 予算を超えたら打ち切る（返す値は使われない）
+    if ((com->node >= com->node_check) && check_budget(com)) {
+        return alpha;
+    }
+
+    // 終盤キャッシュにある局面は上下限から値を返す
+    // 上下限がalpha-beta範囲外か確定値のときは、探索した場合と同じ値になる
+    uint64_t key = 0;
+    int lower, upper;
+    bool use_cache = com->endcache && (depth >= MIN_ENDCACHE_EMPTIES) &&
+                     (depth <= com->endcache_empties) && (depth < com->root_empties);
+    if (use_cache) {
+        key = Board_hash(com->board) ^ ((turn == WHITE) ? WHITE_HASH_KEY : 0);
+        STATS(com->stats.endcache_probes++);
+        if (EndCache_probe(com->endcache, key, &lower, &upper)) {
+            STATS(com->stats.endcache_hits++);
+            if (lower >= beta) {
+                return beta;
+            }
+            if (upper <= alpha) {
+                return alpha;
+            }
+            if (lower == upper) {
+                return lower;
+            }
+        }
+    }
+
     // 残り8手を超える際候補手を並び替える
     if (depth > 8) {
         info_num = sort_moves(com, turn, info);
+        order_pv(com, info, info_num);
+        bool on_pv = com->follow_pv;
 
         if (info_num > 0) {
             *next_move = info[0].move->pos;
@@ -343,20 +989,33 @@ static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool
             Board_flip_pattern(com->board, turn, info[i].move->pos);
             remove_list(info[i].move);
 
-            value = -Com_mid_search(com, opponent, turn, &move, false, -beta, -max, (depth - 1));
+            com->follow_pv = on_pv && (i == 0);
+            com->ply++;
+            value = -Com_end_search(com, opponent, turn, &move, false, -beta, -max, (depth - 1));
+            com->ply--;
 
             Board_unflip_pattern(com->board);
             recover_list(info[i].move);
 
+            // 打ち切った探索の結果は終盤キャッシュへ登録しない
+            if (com->aborted) {
+                return max;
+            }
+
             if (value > max) {
                 max = value;
                 *next_move = info[i].move->pos;
+                update_pv(com, *next_move);
                 if (max >= beta) {
-                    return beta;
+                    STATS(com->stats.cutoffs++; com->stats.first_cutoffs += (i == 0));
+                    max = beta;
+                    break;
                 }
             }
         }
     } else {
+        STATS(int tried = 0);
+
         // 候補手リストを探索
         for (p = com->moves->next; p; (p = p->next)) {
             // パターン更新は行わない
@@ -368,20 +1027,31 @@ static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool
                     can_move = true;
                 }
 
+                com->follow_pv = false;
+                com->ply++;
                 int value = -Com_end_search(com, opponent, turn, &move, false, -beta, -max, (depth - 1));
+                com->ply--;
 
                 Board_unflip(com->board);
                 recover_list(p);
 
+                if (com->aborted) {
+                    return max;
+                }
+
                 // alphaカット
                 if (value > max) {
                     max = value;
                     *next_move = p->pos;
+                    update_pv(com, *next_move);
                     // betaカット
                     if (max >= beta) {
-                        return beta;
+                        STATS(com->stats.cutoffs++; com->stats.first_cutoffs += (tried == 0));
+                        max = beta;
+                        break;
                     }
                 }
+                STATS(tried++);
             }
         }
     }
@@ -391,22 +1061,120 @@ static int Com_end_search(Com *com, int turn, int opponent, int* next_move, bool
             // 互いに有効手ないときゲーム終了、石数差の評価値を返す
             *next_move = NONE;
             com->node++;
-            alpha = (Board_count_disks(com->board, turn) - Board_count_disks(com->board, opponent));
+            max = (Board_count_disks(com->board, turn) - Board_count_disks(com->board, opponent));
         } else {
             // 相手に有効手あるときパス、手番を変更して探索を続ける
+            // パスでは空きマス数は変わらないため探索深さを減らさない
             *next_move = NONE;
-            alpha = -Com_end_search(com, opponent, turn, &move, true, -beta, -max, (depth - 1));
+            com->ply++;
+            max = -Com_end_search(com, opponent, turn, &move, true, -beta, -max, depth);
+            com->ply--;
+            if (com->aborted) {
+                return max;
+            }
+            update_pv(com, NONE);
+        }
+    }
+
+    // 探索結果を上下限として登録する
+    if (use_cache) {
+        if (max >= beta) {
+            EndCache_store(com->endcache, key, max, (BOARD_SIZE * BOARD_SIZE));
+        } else if (max <= alpha) {
+            EndCache_store(com->endcache, key, -(BOARD_SIZE * BOARD_SIZE), max);
+        } else {
+            EndCache_store(com->endcache, key, max, max);
         }
     }
 
     return max;
 }
 
-int Com_count_nodes(const Com *com)
+int Com_sort_moves(Com *com, const Board *board, int color, int *moves)
+{
+    MoveInfo info[BOARD_SIZE * BOARD_SIZE / 2];
+
+    Board_copy(board, com->board);
+    make_move_list(com);
+    Board_init_pattern(com->board);
+
+    int num = sort_moves(com, color, info);
+    for (int i = 0; i < num; i++) {
+        moves[i] = info[i].move->pos;
+    }
+
+    return num;
+}
+
+int Com_get_pv(const Com *com, int *moves)
+{
+    for (int i = 0; i < com->best_pv_length; i++) {
+        moves[i] = com->best_pv[i];
+    }
+
+    return com->best_pv_length;
+}
+
+uint64_t Com_count_nodes(const Com *com)
 {
     return com->node;
 }
 
+void Com_count_total_nodes(const Com *com, unsigned long long *mid, unsigned long long *end)
+{
+    *mid = com->stats.mid_nodes;
+    *end = com->stats.end_nodes;
+}
+
+void Com_count_cache(const Com *com, unsigned long long *hit, unsigned long long *miss)
+{
+    *hit  = com->cache_hit;
+    *miss = com->cache_miss;
+}
+
+void Com_get_stats(const Com *com, ComStats *stats)
+{
+    *stats = com->stats;
+
+    stats->nps = (stats->time > 0) ? (stats->nodes / stats->time) : 0;
+    stats->first_cutoff_rate = (stats->cutoffs > 0) ? ((double)stats->first_cutoffs / stats->cutoffs) : 0;
+}
+
+void Com_reset_stats(Com *com)
+{
+    memset(&com->stats, 0, sizeof(ComStats));
+}
+
+///
+/// @fn     evaluate
+/// @brief  評価値キャッシュを介して局面を評価する
+/// @param[in,out]  com     COM
+/// @return 盤面の評価値
+///
+static int evaluate(Com *com)
+{
+    int value;
+
+    TRACE_SAMPLE_BEGIN("evaluate", -1);
+
+    if (!com->cache) {
+        value = Evaluator_evaluate(com->evaluator, com->board);
+    } else {
+        uint64_t key = Board_hash(com->board);
+        if (EvalCache_probe(com->cache, key, &value)) {
+            com->cache_hit++;
+        } else {
+            com->cache_miss++;
+            value = Evaluator_evaluate(com->evaluator, com->board);
+            EvalCache_store(com->cache, key, value);
+        }
+    }
+
+    TRACE_END();
+
+    return value;
+}
+
 ///
 /// @fn     make_move_list
 /// @brief  候補手リストを作成する
@@ -492,11 +1260,13 @@ static int sort_moves(Com *com, int color, MoveInfo *moveinfo)
     MoveList *p;
     MoveInfo tmp_info, *best_info;
 
+    TRACE_SAMPLE_BEGIN("sort_moves", -1);
+
     // 候補手から着手できる手を探索し評価値をつける
     for (p = com->moves->next; p; (p = p->next)) {
         if (Board_flip_pattern(com->board, color, p->pos) > 0) {
             moveinfo[info_num].move = p;
-            moveinfo[info_num].value = Evaluator_evaluate(com->evaluator, com->board);
+            moveinfo[info_num].value = evaluate(com);
             info_num++;
             Board_unflip_pattern(com->board);
         }
@@ -523,5 +1293,7 @@ static int sort_moves(Com *com, int color, MoveInfo *moveinfo)
         moveinfo[i] = tmp_info;
     }
 
+    TRACE_END();
+
     return info_num;
 }
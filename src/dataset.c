@@ -0,0 +1,407 @@
+///
+/// @file   dataset.c
+/// @brief  学習用局面データセット
+/// @author kentakuramochi
+///
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "dataset.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "record.h"
+
+///
+/// @def    DATASET_FILE_MAGIC
+/// @brief  データセットファイルの識別子
+///
+#define DATASET_FILE_MAGIC "RVDS"
+
+///
+/// @def    DATASET_FILE_VERSION
+/// @brief  データセットファイルの形式バージョン
+///
+#define DATASET_FILE_VERSION 2
+
+///
+/// @struct DatasetHeader
+/// @brief  データセットファイルのヘッダ
+/// @note   ヘッダに続けてDatasetEntryを局面数ぶん格納する
+///
+typedef struct {
+    char     magic[4];      ///< 識別子
+    int32_t  version;       ///< 形式バージョン
+    int32_t  num_pattern;   ///< パターンID数
+    int32_t  entry_size;    ///< 1局面のバイト数
+    uint64_t num;           ///< 局面数
+} DatasetHeader;
+
+///
+/// @struct Dataset_
+/// @brief  学習用局面データセット
+///
+struct Dataset_ {
+    void               *map;        ///< ファイルの割り当て先
+    size_t             map_size;    ///< 割り当てたバイト数
+    const DatasetEntry *entries;    ///< 局面
+    size_t             num;         ///< 局面数
+};
+
+///
+/// @struct PositionStat
+/// @brief  データセット作成時の局面ごとの集計
+///
+typedef struct {
+    uint64_t hash;      ///< 対称変換によらないハッシュ値（0は空き）
+    double   sum;       ///< 石数差の合計
+    uint32_t count;     ///< 出現回数
+    bool     written;   ///< 書き出し済みか
+} PositionStat;
+
+///
+/// @struct PositionTable
+/// @brief  局面ごとの集計表（オープンアドレス法）
+///
+typedef struct {
+    PositionStat *stats;    ///< 集計
+    size_t       size;      ///< 表の大きさ（2の冪乗）
+    size_t       num;       ///< 登録した局面数
+} PositionTable;
+
+static bool read_game(RecordReader *reader, Board *board, Record *record, int *colors);
+static PositionStat *find_stat(PositionTable *table, uint64_t hash);
+static bool grow_table(PositionTable *table);
+static void *map_file(const char *file, size_t *size);
+static void unmap_file(void *map, size_t size);
+
+void Dataset_extract(Board *board, const int *colors, int num, DatasetEntry *entries, uint64_t *hashes)
+{
+    // 終局時の石数差
+    int result = Board_count_disks(board, BLACK) - Board_count_disks(board, WHITE);
+
+    for (int turn = (num - 1); turn >= 0; turn--) {
+        DatasetEntry *entry = &entries[turn];
+
+        // 構造体の詰め物もファイルへ書き出すため、同じ入力から同じファイルとなるよう0で埋める
+        memset(entry, 0, sizeof(DatasetEntry));
+
+        Board_unflip(board);
+        if (colors[turn] == BLACK) {
+            Board_init_pattern(board);
+            entry->result = (float)result;
+        } else {
+            // 黒番に揃える: 色反転し石数差の符号を反転する
+            Board_reverse(board);
+            entry->result = (float)-result;
+        }
+
+        const int *index = Board_pattern_list(board);
+        for (int i = 0; i < NUM_PATTERN_ID; i++) {
+            entry->index[i] = (uint16_t)index[i];
+        }
+        entry->empties = (uint8_t)Board_count_disks(board, EMPTY);
+        entry->weight  = 1;
+        hashes[turn]   = Board_canonical_hash(board);
+
+        if (colors[turn] != BLACK) {
+            Board_reverse(board);
+        }
+    }
+}
+
+///
+/// @fn     read_game
+/// @brief  棋譜を1局読み込み、終局まで再生する
+/// @param[in,out]  reader  棋譜の読み込み器
+/// @param[out] board   終局時の盤面
+/// @param[out] record  棋譜
+/// @param[out] colors  各着手の手番色
+/// @retval true    読み込み成功
+/// @retval false   ファイル終端
+/// @note   再生できない棋譜・結果の一致しない棋譜は読み飛ばす
+///
+static bool read_game(RecordReader *reader, Board *board, Record *record, int *colors)
+{
+    while (RecordReader_next(reader, record, board, colors)) {
+        if (!Board_can_play(board, BLACK) && !Board_can_play(board, WHITE) &&
+            ((Board_count_disks(board, BLACK) - Board_count_disks(board, WHITE)) == record->result)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+///
+/// @fn     find_stat
+/// @brief  局面の集計を探す
+/// @param[in]  table   集計表
+/// @param[in]  hash    対称変換によらないハッシュ値
+/// @return 集計（未登録のときは空きエントリ）
+///
+static PositionStat *find_stat(PositionTable *table, uint64_t hash)
+{
+    // ハッシュ値0は空きを表すため置き換える
+    if (hash == 0) {
+        hash = 1;
+    }
+
+    size_t i = (size_t)hash & (table->size - 1);
+    while (table->stats[i].hash && (table->stats[i].hash != hash)) {
+        i = (i + 1) & (table->size - 1);
+    }
+    table->stats[i].hash = hash;
+
+    return &table->stats[i];
+}
+
+///
+/// @fn     grow_table
+/// @brief  集計表を2倍に広げる
+/// @param[in,out]  table   集計表
+/// @retval true    拡張成功
+/// @retval false   メモリ確保失敗
+///
+static bool grow_table(PositionTable *table)
+{
+    PositionTable grown = { calloc(table->size * 2, sizeof(PositionStat)), table->size * 2, table->num };
+    if (!grown.stats) {
+        return false;
+    }
+
+    for (size_t i = 0; i < table->size; i++) {
+        if (table->stats[i].hash) {
+            *find_stat(&grown, table->stats[i].hash) = table->stats[i];
+        }
+    }
+
+    free(table->stats);
+    *table = grown;
+
+    return true;
+}
+
+///
+/// @fn     map_file
+/// @brief  ファイル全体を読み出し専用でメモリへ割り当てる
+/// @param[in]  file    ファイル名
+/// @param[out] size    バイト数
+/// @return 割り当て先（失敗時・空のファイルはNULL）
+/// @note   POSIXではmmapで割り当て、参照時にファイルから読み出す
+///         mmapのないWindowsでは確保したメモリへ一括で読み込む
+///
+static void *map_file(const char *file, size_t *size)
+{
+#ifdef _WIN32
+    FILE *fp = fopen(file, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    void *map = NULL;
+    long len;
+    if ((fseek(fp, 0, SEEK_END) == 0) && ((len = ftell(fp)) > 0) && (fseek(fp, 0, SEEK_SET) == 0)) {
+        map = malloc(len);
+        if (map && (fread(map, 1, len, fp) != (size_t)len)) {
+            free(map);
+            map = NULL;
+        }
+        *size = len;
+    }
+    fclose(fp);
+
+    return map;
+#else
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    void *map = NULL;
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            map = NULL;
+        } else {
+            *size = st.st_size;
+            // 学習では先頭から順に読み出す
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+
+    // 割り当て後はファイルを閉じてよい
+    close(fd);
+
+    return map;
+#endif
+}
+
+///
+/// @fn     unmap_file
+/// @brief  map_fileで割り当てたメモリを解放する
+/// @param[in,out]  map     割り当て先
+/// @param[in]      size    バイト数
+///
+static void unmap_file(void *map, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    free(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+bool Dataset_build(const char *game_file, const char *dataset_file, size_t *total, size_t *num)
+{
+    RecordReader *in = RecordReader_open(game_file);
+    FILE *out = fopen(dataset_file, "wb");
+    Board *board = Board_create();
+    PositionTable table = { calloc(1 << 16, sizeof(PositionStat)), 1 << 16, 0 };
+    bool result = (in && out && board && table.stats);
+
+    DatasetHeader header;
+    memcpy(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic));
+    header.version     = DATASET_FILE_VERSION;
+    header.num_pattern = NUM_PATTERN_ID;
+    header.entry_size  = sizeof(DatasetEntry);
+    header.num         = 0;
+
+    Record       record;
+    int          colors[MAX_RECORD_MOVES];
+    DatasetEntry entries[MAX_RECORD_MOVES];
+    uint64_t     hashes[MAX_RECORD_MOVES];
+    size_t       count = 0;
+
+    // 1回目: 局面ごとに出現回数と石数差を集計する
+    while (result && read_game(in, board, &record, colors)) {
+        Dataset_extract(board, colors, record.num, entries, hashes);
+        for (int i = 0; result && (i < record.num); i++) {
+            // 負荷率1/2を超えたら広げる
+            if ((table.num * 2 >= table.size) && !grow_table(&table)) {
+                result = false;
+                break;
+            }
+            PositionStat *stat = find_stat(&table, hashes[i]);
+            if (stat->count == 0) {
+                table.num++;
+            }
+            stat->sum += entries[i].result;
+            stat->count++;
+            count++;
+        }
+    }
+
+    // 局面数は書き出し後に確定するため、ヘッダを仮に書いておく
+    if (result) {
+        result = (fwrite(&header, sizeof(header), 1, out) == 1);
+        RecordReader_rewind(in);
+    }
+
+    // 2回目: 初出の局面を出現回数・石数差の平均とともに書き出す
+    while (result && read_game(in, board, &record, colors)) {
+        Dataset_extract(board, colors, record.num, entries, hashes);
+        for (int i = 0; result && (i < record.num); i++) {
+            PositionStat *stat = find_stat(&table, hashes[i]);
+            if (!stat->written) {
+                entries[i].weight = stat->count;
+                entries[i].result = (float)(stat->sum / stat->count);
+                result = (fwrite(&entries[i], sizeof(DatasetEntry), 1, out) == 1);
+                stat->written = true;
+                header.num++;
+            }
+        }
+    }
+
+    if (result) {
+        result = (fseek(out, 0, SEEK_SET) == 0) &&
+                 (fwrite(&header, sizeof(header), 1, out) == 1);
+    }
+
+    if (total) {
+        *total = count;
+    }
+    if (num) {
+        *num = (size_t)header.num;
+    }
+
+    free(table.stats);
+    if (board) {
+        Board_delete(board);
+    }
+    if (out && (fclose(out) != 0)) {
+        result = false;
+    }
+    if (in) {
+        RecordReader_close(in);
+    }
+
+    return result;
+}
+
+Dataset *Dataset_open(const char *file)
+{
+    size_t  size;
+    void    *map = map_file(file, &size);
+    Dataset *dataset = NULL;
+
+    if (!map) {
+        return NULL;
+    }
+
+    const DatasetHeader *header = map;
+
+    // 識別子、形式バージョン、局面の構成、ファイル長の一致を確認する
+    if ((size >= sizeof(DatasetHeader)) &&
+        (memcmp(header->magic, DATASET_FILE_MAGIC, sizeof(header->magic)) == 0) &&
+        (header->version == DATASET_FILE_VERSION) &&
+        (header->num_pattern == NUM_PATTERN_ID) &&
+        (header->entry_size == sizeof(DatasetEntry)) &&
+        (header->num <= ((size - sizeof(DatasetHeader)) / sizeof(DatasetEntry)))) {
+        dataset = malloc(sizeof(Dataset));
+    }
+
+    if (dataset) {
+        dataset->map      = map;
+        dataset->map_size = size;
+        dataset->entries  = (const DatasetEntry *)((const char *)map + sizeof(DatasetHeader));
+        dataset->num      = header->num;
+    } else {
+        unmap_file(map, size);
+    }
+
+    return dataset;
+}
+
+void Dataset_close(Dataset *dataset)
+{
+    if (!dataset) {
+        return;
+    }
+
+    unmap_file(dataset->map, dataset->map_size);
+
+    free(dataset);
+    dataset = NULL;
+}
+
+size_t Dataset_size(const Dataset *dataset)
+{
+    return dataset->num;
+}
+
+const DatasetEntry *Dataset_entry(const Dataset *dataset, size_t i)
+{
+    return &dataset->entries[i];
+}
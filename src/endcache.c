@@ -0,0 +1,178 @@
+///
+/// @file   endcache.c
+/// @brief  終盤探索結果のキャッシュ
+/// @author kentakuramochi
+///
+
+#include "endcache.h"
+#include "safefile.h"
+#include "hashslot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///
+/// @def    ENDCACHE_FILE_MAGIC
+/// @brief  終盤キャッシュファイルの識別子
+///
+#define ENDCACHE_FILE_MAGIC "RVEC"
+
+///
+/// @def    ENDCACHE_FILE_VERSION
+/// @brief  終盤キャッシュファイルの形式バージョン
+///
+#define ENDCACHE_FILE_VERSION 1
+
+///
+/// @def    SCORE_OFFSET
+/// @brief  石数差を符号なしで格納するためのオフセット
+///
+#define SCORE_OFFSET 64
+
+///
+/// @struct EndCache_
+/// @brief  終盤探索結果のキャッシュ
+/// @note   エントリのデータは石数差の上下限（下位8bit: 下限、次の8bit: 上限）
+///
+struct EndCache_ {
+    HashSlot *entry;    ///< エントリ
+    uint64_t mask;      ///< インデックスマスク（エントリ数 - 1）
+};
+
+EndCache *EndCache_create(int size)
+{
+    if (size <= 0) {
+        return NULL;
+    }
+
+    EndCache *cache = malloc(sizeof(EndCache));
+    if (!cache) {
+        return NULL;
+    }
+
+    cache->entry = HashSlot_create(size, &cache->mask);
+    if (!cache->entry) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void EndCache_delete(EndCache *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    free(cache->entry);
+    free(cache);
+    cache = NULL;
+}
+
+void EndCache_clear(EndCache *cache)
+{
+    HashSlot_clear(cache->entry, cache->mask);
+}
+
+bool EndCache_probe(EndCache *cache, uint64_t key, int *lower, int *upper)
+{
+    uint64_t data;
+
+    if (!HashSlot_load(&cache->entry[key & cache->mask], key, &data)) {
+        return false;
+    }
+
+    *lower = (int)(data & 0xFF) - SCORE_OFFSET;
+    *upper = (int)((data >> 8) & 0xFF) - SCORE_OFFSET;
+
+    return true;
+}
+
+void EndCache_store(EndCache *cache, uint64_t key, int lower, int upper)
+{
+    int prev_lower, prev_upper;
+
+    // 同じ局面の上下限があれば狭める
+    if (EndCache_probe(cache, key, &prev_lower, &prev_upper) &&
+        (prev_lower <= upper) && (lower <= prev_upper)) {
+        if (prev_lower > lower) {
+            lower = prev_lower;
+        }
+        if (prev_upper < upper) {
+            upper = prev_upper;
+        }
+    }
+
+    uint64_t data = (uint64_t)(lower + SCORE_OFFSET) | ((uint64_t)(upper + SCORE_OFFSET) << 8);
+
+    HashSlot_store(&cache->entry[key & cache->mask], key, data);
+}
+
+bool EndCache_load(EndCache *cache, const char *file)
+{
+    FILE *fp = fopen(file, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    char     magic[sizeof(ENDCACHE_FILE_MAGIC) - 1];
+    int      version;
+    uint64_t num;
+    bool     result = (fread(magic, sizeof(magic), 1, fp) == 1) &&
+                      (memcmp(magic, ENDCACHE_FILE_MAGIC, sizeof(magic)) == 0) &&
+                      (fread(&version, sizeof(int), 1, fp) == 1) &&
+                      (version == ENDCACHE_FILE_VERSION) &&
+                      (fread(&num, sizeof(uint64_t), 1, fp) == 1);
+
+    // 登録済みのエントリのみ書き出されているため、キーから登録し直す
+    for (uint64_t i = 0; result && (i < num); i++) {
+        uint64_t entry[2];
+        if (fread(entry, sizeof(uint64_t), 2, fp) != 2) {
+            result = false;
+        } else if (!(entry[1] >> 16)) {
+            EndCache_store(cache, entry[0] ^ entry[1],
+                           (int)(entry[1] & 0xFF) - SCORE_OFFSET,
+                           (int)((entry[1] >> 8) & 0xFF) - SCORE_OFFSET);
+        }
+    }
+
+    fclose(fp);
+
+    return result;
+}
+
+bool EndCache_save(EndCache *cache, const char *file)
+{
+    FILE *fp = SafeFile_open(file);
+    if (!fp) {
+        return false;
+    }
+
+    // 識別子、形式バージョン、エントリ数に続けて登録済みのエントリを書き出す
+    int      version = ENDCACHE_FILE_VERSION;
+    uint64_t num = 0;
+    bool     result = (fwrite(ENDCACHE_FILE_MAGIC, sizeof(ENDCACHE_FILE_MAGIC) - 1, 1, fp) == 1) &&
+                      (fwrite(&version, sizeof(int), 1, fp) == 1) &&
+                      (fwrite(&num, sizeof(uint64_t), 1, fp) == 1);
+
+    for (uint64_t i = 0; result && (i <= cache->mask); i++) {
+        // ファイルにはエントリの検査値とデータをそのまま書き出す
+        uint64_t key, entry[2];
+        entry[1] = HashSlot_peek(&cache->entry[i], &key);
+        entry[0] = key ^ entry[1];
+        if (entry[1] != HASHSLOT_EMPTY) {
+            result = (fwrite(entry, sizeof(uint64_t), 2, fp) == 2);
+            num++;
+        }
+    }
+
+    // エントリ数を確定する
+    if (result) {
+        result = (fseek(fp, sizeof(ENDCACHE_FILE_MAGIC) - 1 + sizeof(int), SEEK_SET) == 0) &&
+                 (fwrite(&num, sizeof(uint64_t), 1, fp) == 1);
+    }
+
+    return SafeFile_close(fp, file, result);
+}
@@ -0,0 +1,74 @@
+///
+/// @file   evalcache.c
+/// @brief  局面評価値のキャッシュ
+/// @author kentakuramochi
+///
+
+#include "evalcache.h"
+#include "hashslot.h"
+
+#include <stdlib.h>
+
+///
+/// @struct EvalCache_
+/// @brief  評価値キャッシュ
+/// @note   エントリのデータは評価値（下位32bit）
+///
+struct EvalCache_ {
+    HashSlot *entry;    ///< エントリ
+    uint64_t mask;      ///< インデックスマスク（エントリ数 - 1）
+};
+
+EvalCache *EvalCache_create(int size)
+{
+    if (size <= 0) {
+        return NULL;
+    }
+
+    EvalCache *cache = malloc(sizeof(EvalCache));
+    if (!cache) {
+        return NULL;
+    }
+
+    cache->entry = HashSlot_create(size, &cache->mask);
+    if (!cache->entry) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void EvalCache_delete(EvalCache *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    free(cache->entry);
+    free(cache);
+    cache = NULL;
+}
+
+void EvalCache_clear(EvalCache *cache)
+{
+    HashSlot_clear(cache->entry, cache->mask);
+}
+
+bool EvalCache_probe(EvalCache *cache, uint64_t key, int *value)
+{
+    uint64_t data;
+
+    if (!HashSlot_load(&cache->entry[key & cache->mask], key, &data)) {
+        return false;
+    }
+
+    *value = (int32_t)(uint32_t)data;
+
+    return true;
+}
+
+void EvalCache_store(EvalCache *cache, uint64_t key, int value)
+{
+    HashSlot_store(&cache->entry[key & cache->mask], key, (uint32_t)value);
+}
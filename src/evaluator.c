@@ -5,12 +5,18 @@
 ///
 
 #include "evaluator.h"
+#include "safefile.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_AVX2
+#include <immintrin.h>
+#endif
+
 ///
 /// @def    UPDATE_RATIO
 /// @brief  評価値の更新率
@@ -30,80 +36,109 @@
 ///
 #define MIN_FREQUNECY 10
 
+///
+/// @def    STAGE_WIDTH
+/// @brief  評価値を切り替える空きマス数の幅
+///
+#define STAGE_WIDTH 4
+
+///
+/// @def    NUM_STAGE
+/// @brief  評価値を切り替える進行段階の数
+///
+#define NUM_STAGE (((BOARD_SIZE * BOARD_SIZE) - 4) / STAGE_WIDTH + 1)
+
+///
+/// @def    STAGE
+/// @brief  空きマス数から進行段階を求める
+///
+#define STAGE(empties) ((empties) / STAGE_WIDTH)
+
+///
+/// @def    EVAL_FILE_MAGIC
+/// @brief  評価値ファイルの識別子
+/// @note   識別子のないファイルは全パターン状態を1段階ぶん持つ旧形式として扱う
+///
+#define EVAL_FILE_MAGIC "RVEV"
+
+///
+/// @def    EVAL_FILE_VERSION
+/// @brief  評価値ファイルの形式バージョン
+///
+#define EVAL_FILE_VERSION 1
+
 ///
 /// @enum   Pattern
 /// @brief  評価対象のパターン
-/// @note   Logistelloのパターンを元に簡略化されたもの
-///         (http://www.es-cube.net/es-cube/reversi/sample/html/3_2.html)
+/// @note   pattern.hのPATTERN_TYPE_LISTから生成する
 ///
 typedef enum {
-    PATTERN_HV4,        ///< hor./vert.4: 水平/垂直ラインパターン
-    PATTERN_HV3,        ///< hor./vert.3
-    PATTERN_HV2,        ///< hor./vert.2
-    PATTERN_DIAG8,      ///< diag8: 対角線パターン
-    PATTERN_DIAG7,      ///< diag7
-    PATTERN_DIAG6,      ///< diag6
-    PATTERN_DIAG5,      ///< diag5
-    PATTERN_DIAG4,      ///< diag4
-    PATTERN_EDGE8,      ///< edge: 辺パターン
-    PATTERN_CORNER8,    ///< corner: 角パターン
+#define PATTERN_ENUM(type) PATTERN_##type,
+    PATTERN_TYPE_LIST(PATTERN_ENUM)
+#undef PATTERN_ENUM
     PATTERN_PARITY,     ///< パリティ
     NUM_PATTERN         ///< パターン数
 } Pattern;
 
 ///
-/// @enum   Pow3
-/// @brief  3の冪乗数
-/// @note   各マス数に応じた評価パターンの状態数を示す: （BLACK/WHITE/EMPTY）^（マス数）
+/// @def    NUM_SYMMETRY
+/// @brief  盤面の対称変換の数（回転・鏡映）
 ///
-typedef enum {
-    POW3_0  = 1,
-    POW3_1  = 3,
-    POW3_2  = 9,
-    POW3_3  = 27,
-    POW3_4  = 81,
-    POW3_5  = 243,
-    POW3_6  = 729,
-    POW3_7  = 2187,
-    POW3_8  = 6561,
-    POW3_9  = 19683,
-    POW3_10 = 59049
-} Pow3;
-
-// 各評価パターンの状態数: マス数に対応
-static const int pattern_size[] = {
-    POW3_8, // hor./vert.4: A4-H4
-    POW3_8, // hor./vert.3: A3-H3
-    POW3_8, // hor./vert.2: A2-H2
-    POW3_8, // diag8:       A1-H8
-    POW3_7, // diag7:       A2-G8
-    POW3_6, // diag6:       A3-F8
-    POW3_5, // diag5:       A4-E8
-    POW3_4, // diag4:       A5-D8
-    POW3_8, // edge:        A1-G1 + B2
-    POW3_8, // corner:      A1-C1 + A2-C2 + A3-B3
-    2,      // parity
-    0       // dummy
+#define NUM_SYMMETRY 8
+
+// 各パターンIDが参照する評価パターン
+static const int pattern_type[NUM_PATTERN_ID] = {
+#define PATTERN_TYPE(name, type, ...) PATTERN_##type,
+    PATTERN_ID_LIST(PATTERN_TYPE)
+#undef PATTERN_TYPE
+};
+
+// 各パターンIDの構成マス（-1終端）
+static const int pattern_squares[NUM_PATTERN_ID][MAX_PATTERN_SQUARES + 1] = {
+#define PATTERN_SQUARES(name, type, ...) { __VA_ARGS__, -1 },
+    PATTERN_ID_LIST(PATTERN_SQUARES)
+#undef PATTERN_SQUARES
 };
 
 ///
 /// @struct Evaluator_
 /// @brief  評価器
+/// @note   評価値は対称なパターンをまとめた代表パターン（正規パターン）のみ、進行段階ごとに保持する
 ///
 struct Evaluator_ {
-    int    *values[NUM_PATTERN];        ///< 各パターンに対する評価値
-    int    *pattern_num[NUM_PATTERN];   ///< パターンの出現回数
-    double *pattern_sum[NUM_PATTERN];   ///< 評価値差分の合計
-    int    mirror_line[POW3_8];         ///< 対称な列パターンを調べるための変数
-    int    mirror_corner[POW3_8];       ///< 対称なコーナーパターンを調べるための変数
+    int            *weights;            ///< 正規パターンの評価値（進行段階 x 全パターン連続領域）
+    unsigned short *index_map;          ///< パターン状態から評価値位置への変換表（全パターン連続領域）
+    unsigned short *map[NUM_PATTERN];   ///< 各パターンの変換表（index_map内の先頭）
+    int            offset[NUM_PATTERN_ID];  ///< 各パターンIDの変換表のindex_map内オフセット
+    int            num_weights;         ///< 1段階あたりの正規パターンの評価値数
+    int            num_index;           ///< 全パターンの状態数
+    int            pattern_size[NUM_PATTERN];   ///< 各パターンの状態数
+    int            (*evaluate)(const Evaluator *, const Board *);  ///< 局面評価関数
+    int            *pattern_num;        ///< 正規パターンの出現回数
+    double         *pattern_sum;        ///< 正規パターンの評価値差分の合計
+    int            *dirty;              ///< 出現回数が0でない評価値位置の一覧
+    int            num_dirty;           ///< 出現回数が0でない評価値位置の数
+    int            version;             ///< 評価値の更新回数
+    Evaluator      *parent;             ///< 評価値を共有する元の評価器（Evaluator_forkで生成した場合）
 };
 
 static bool initialize(Evaluator *eval);
 static void finalize(Evaluator *eval);
 
-static void add_pattern(Evaluator* eval, int pattern, int id, int mirror, double diff);
+static int init_pattern_size(Evaluator *eval);
+static int init_symmetry(int pattern, int coeff[][MAX_PATTERN_SQUARES]);
+static int canonical_pattern(int index, int num_sym, int coeff[][MAX_PATTERN_SQUARES]);
 
-static void update_pattern(Evaluator *eval, int pattern, int id);
+static bool load_legacy(Evaluator *eval, FILE *fp);
+
+static int evaluate_scalar(const Evaluator *eval, const Board *board);
+#ifdef USE_AVX2
+static int evaluate_avx2(const Evaluator *eval, const Board *board);
+#endif
+
+static void add_pattern(Evaluator* eval, int id, double diff, int weight);
+
+static bool update_pattern(Evaluator *eval, int id);
 
 ///
 /// @fn     initialize
@@ -116,61 +151,62 @@ static bool initialize(Evaluator *eval)
 {
     memset(eval, 0, sizeof(Evaluator));
 
+    // 変換表はベクトル化した一括参照のため連続領域に確保する
+    // gatherは4バイト単位で読み出すため末尾に1要素余分に確保する
+    eval->num_index = init_pattern_size(eval);
+    eval->index_map = calloc(eval->num_index + 1, sizeof(unsigned short));
+    if (!eval->index_map) {
+        return false;
+    }
+
+    int base = 0;
     for (int i = 0; i < NUM_PATTERN; i++) {
-        eval->values[i] = calloc(pattern_size[i], sizeof(int));
-        if (!eval->values[i]) {
-            return false;
-        }
+        eval->map[i] = eval->index_map + base;
+        base += eval->pattern_size[i];
+    }
+    for (int i = 0; i < NUM_PATTERN_ID; i++) {
+        eval->offset[i] = (int)(eval->map[pattern_type[i]] - eval->index_map);
+    }
 
-        eval->pattern_num[i] = calloc(pattern_size[i], sizeof(int));
-        if (!eval->pattern_num[i]) {
-            return false;
+    // 対称なパターン状態を同じ評価値位置へ対応づける
+    // 対称な状態のうち状態番号の最も小さいものを正規パターンとする
+    int coeff[NUM_SYMMETRY][MAX_PATTERN_SQUARES];
+    eval->num_weights = 0;
+    for (int i = 0; i < NUM_PATTERN; i++) {
+        int num_sym = init_symmetry(i, coeff);
+        for (int j = 0; j < eval->pattern_size[i]; j++) {
+            int canonical = canonical_pattern(j, num_sym, coeff);
+            if (canonical < j) {
+                eval->map[i][j] = eval->map[i][canonical];
+            } else {
+                eval->map[i][j] = eval->num_weights++;
+            }
         }
+    }
 
-        eval->pattern_sum[i] = calloc(pattern_size[i], sizeof(double));
-        if (!eval->pattern_sum[i]) {
-            return false;
-        }
+    eval->weights = calloc(eval->num_weights * NUM_STAGE, sizeof(int));
+    if (!eval->weights) {
+        return false;
     }
 
-    int mirror_in, mirror_out, coeff;
-    int mirror_corner_coeff[] = {
-        POW3_2, POW3_5, POW3_0, POW3_3, POW3_6, POW3_1, POW3_4, POW3_7
-    };
-
-    // 対称パターン調べる変数の初期化
-    for (int i = 0; i < POW3_8; i++) {
-        mirror_in  = i;
-        mirror_out = 0;
-        coeff = POW3_7;
-        for (int j = 0; j < 8; j++) {
-            mirror_out += mirror_in % 3 * coeff;
-            mirror_in /= 3;
-            coeff /= 3;
-        }
-        if (mirror_out < i) {
-            eval->mirror_line[i] = mirror_out;
-        } else {
-            eval->mirror_line[i] = i;
-        }
+    eval->pattern_num = calloc(eval->num_weights * NUM_STAGE, sizeof(int));
+    if (!eval->pattern_num) {
+        return false;
     }
 
-    // 対称コーナーパターン調べる変数の初期化
-    for (int i = 0; i < POW3_8; i++) {
-        mirror_in  = i;
-        mirror_out = 0;
-        coeff = POW3_7;
-        for (int j = 0; j < 8; j++) {
-            mirror_out += mirror_in % 3 * mirror_corner_coeff[j];
-            mirror_in /= 3;
-        }
-        if (mirror_out < i) {
-            eval->mirror_corner[i] = mirror_out;
-        } else {
-            eval->mirror_corner[i] = i;
-        }
+    eval->pattern_sum = calloc(eval->num_weights * NUM_STAGE, sizeof(double));
+    if (!eval->pattern_sum) {
+        return false;
     }
 
+    eval->dirty = malloc(eval->num_weights * NUM_STAGE * sizeof(int));
+    if (!eval->dirty) {
+        return false;
+    }
+
+    // 実行環境に応じて評価関数を選択する
+    Evaluator_set_kernel(eval, EVAL_KERNEL_AUTO);
+
     return true;
 }
 
@@ -181,19 +217,162 @@ static bool initialize(Evaluator *eval)
 ///
 static void finalize(Evaluator *eval)
 {
+    if (eval->dirty) {
+        free(eval->dirty);
+    }
+
+    if (eval->pattern_sum) {
+        free(eval->pattern_sum);
+    }
+
+    if (eval->pattern_num) {
+        free(eval->pattern_num);
+    }
+
+    // 共有している評価値・変換表は元の評価器が破棄する
+    if (eval->parent) {
+        return;
+    }
+
+    if (eval->weights) {
+        free(eval->weights);
+    }
+
+    if (eval->index_map) {
+        free(eval->index_map);
+    }
+}
+
+///
+/// @fn     init_pattern_size
+/// @brief  各パターンの状態数を求める
+/// @param[in,out]  eval    評価器
+/// @return 全パターンの状態数
+/// @note   状態数は構成マス数に対して 3^（マス数）（BLACK/WHITE/EMPTY）
+///
+static int init_pattern_size(Evaluator *eval)
+{
+    int total = 0;
+
     for (int i = 0; i < NUM_PATTERN; i++) {
-        if (eval->pattern_sum[i]) {
-            free(eval->pattern_sum[i]);
+        eval->pattern_size[i] = 0;
+    }
+    eval->pattern_size[PATTERN_PARITY] = 2;
+
+    for (int i = 0; i < NUM_PATTERN_ID; i++) {
+        int size = 1;
+        for (int j = 0; pattern_squares[i][j] >= 0; j++) {
+            size *= 3;
         }
+        eval->pattern_size[pattern_type[i]] = size;
+    }
+
+    for (int i = 0; i < NUM_PATTERN; i++) {
+        total += eval->pattern_size[i];
+    }
+
+    return total;
+}
 
-        if (eval->pattern_num[i]) {
-            free(eval->pattern_num[i]);
+///
+/// @fn     init_symmetry
+/// @brief  パターン自身へ移る盤面の対称変換を求める
+/// @param[in]  pattern パターン
+/// @param[out] coeff   対称変換ごとの、各構成マスの移動先の桁の重み
+/// @return パターン自身へ移る対称変換の数（恒等変換を含む、盤面上にないパターンは0）
+/// @note   パターンの種類ごとに最初のパターンIDの構成マスで判定する
+///
+static int init_symmetry(int pattern, int coeff[][MAX_PATTERN_SQUARES])
+{
+    const int *squares = NULL;
+    int num = 0;
+    int num_sym = 0;
+
+    for (int i = 0; i < NUM_PATTERN_ID; i++) {
+        if (pattern_type[i] == pattern) {
+            squares = pattern_squares[i];
+            break;
         }
+    }
+
+    // パリティなど盤面上にないパターンは対称性を持たない
+    if (!squares) {
+        return 0;
+    }
 
-        if (eval->values[i]) {
-            free(eval->values[i]);
+    for (num = 0; squares[num] >= 0; num++);
+
+    for (int sym = 0; sym < NUM_SYMMETRY; sym++) {
+        bool match = true;
+
+        for (int i = 0; (i < num) && match; i++) {
+            int x = Board_x(squares[i]);
+            int y = Board_y(squares[i]);
+            int tmp;
+
+            // 対称変換: bit0 左右反転、bit1 上下反転、bit2 対角線反転
+            if (sym & 1) {
+                x = (BOARD_SIZE - 1) - x;
+            }
+            if (sym & 2) {
+                y = (BOARD_SIZE - 1) - y;
+            }
+            if (sym & 4) {
+                tmp = x;
+                x   = y;
+                y   = tmp;
+            }
+
+            // 移動先のマスが何桁目かを探す
+            int pos = Board_pos(x, y);
+            int j;
+            for (j = 0; (j < num) && (squares[j] != pos); j++);
+            if (j < num) {
+                coeff[num_sym][i] = 1;
+                while (j-- > 0) {
+                    coeff[num_sym][i] *= 3;
+                }
+            } else {
+                match = false;
+            }
+        }
+
+        if (match) {
+            for (int i = num; i < MAX_PATTERN_SQUARES; i++) {
+                coeff[num_sym][i] = 0;
+            }
+            num_sym++;
         }
     }
+
+    return num_sym;
+}
+
+///
+/// @fn     canonical_pattern
+/// @brief  正規パターンの状態を取得する
+/// @param[in]  index   パターン状態
+/// @param[in]  num_sym パターン自身へ移る対称変換の数
+/// @param[in]  coeff   対称変換ごとの、各構成マスの移動先の桁の重み
+/// @return 対称なパターン状態のうち最小のもの
+///
+static int canonical_pattern(int index, int num_sym, int coeff[][MAX_PATTERN_SQUARES])
+{
+    int canonical = index;
+
+    for (int sym = 0; sym < num_sym; sym++) {
+        int in = index;
+        int mirror = 0;
+        for (int i = 0; (i < MAX_PATTERN_SQUARES) && (in > 0); i++) {
+            mirror += in % 3 * coeff[sym][i];
+            in /= 3;
+        }
+        if (mirror < canonical) {
+            canonical = mirror;
+        }
+    }
+
+    return canonical;
 }
 
 Evaluator *Evaluator_create(void)
@@ -203,6 +382,7 @@ Evaluator *Evaluator_create(void)
     if (eval) {
         if (!initialize(eval)) {
             finalize(eval);
+            free(eval);
             eval = NULL;
         }
     }
@@ -210,6 +390,28 @@ Evaluator *Evaluator_create(void)
     return eval;
 }
 
+Evaluator *Evaluator_fork(Evaluator *eval)
+{
+    Evaluator *fork = malloc(sizeof(Evaluator));
+
+    if (fork) {
+        // 評価値・変換表は共有し、学習用の集計のみ個別に持つ
+        *fork = *eval;
+        fork->parent = (eval->parent ? eval->parent : eval);
+        fork->pattern_num = calloc(eval->num_weights * NUM_STAGE, sizeof(int));
+        fork->pattern_sum = calloc(eval->num_weights * NUM_STAGE, sizeof(double));
+        fork->dirty       = malloc(eval->num_weights * NUM_STAGE * sizeof(int));
+        fork->num_dirty   = 0;
+        if (!fork->pattern_num || !fork->pattern_sum || !fork->dirty) {
+            finalize(fork);
+            free(fork);
+            fork = NULL;
+        }
+    }
+
+    return fork;
+}
+
 
 void Evaluator_delete(Evaluator *eval)
 {
@@ -230,243 +432,400 @@ bool Evaluator_load(Evaluator *eval, const char *file)
         return false;
     }
 
-    // 読み込んだ評価値を設定する
-    for (int i = 0; i < NUM_PATTERN; i++) {
-        if (fread(eval->values[i], sizeof(int), pattern_size[i], fp) < (size_t)pattern_size[i]) {
-            fclose(fp);
-            return false;
-        }
+    char magic[sizeof(EVAL_FILE_MAGIC) - 1];
+    int  header[3];
+    bool result;
+
+    if ((fread(magic, sizeof(magic), 1, fp) == 1) &&
+        (memcmp(magic, EVAL_FILE_MAGIC, sizeof(magic)) == 0)) {
+        // 形式バージョン、段階数、評価値数の一致を確認し一括で読み込む
+        result = (fread(header, sizeof(int), 3, fp) == 3) &&
+                 (header[0] == EVAL_FILE_VERSION) &&
+                 (header[1] == NUM_STAGE) &&
+                 (header[2] == eval->num_weights) &&
+                 (fread(eval->weights, sizeof(int), eval->num_weights * NUM_STAGE, fp) == (size_t)(eval->num_weights * NUM_STAGE));
+    } else {
+        rewind(fp);
+        result = load_legacy(eval, fp);
     }
 
     fclose(fp);
 
-    return true;
+    eval->version++;
+
+    return result;
+}
+
+///
+/// @fn     load_legacy
+/// @brief  旧形式の評価値ファイルから評価値を読み込む
+/// @param[in,out]  eval    評価器
+/// @param[in]      fp      評価値ファイル
+/// @retval true    読み込み成功
+/// @retval false   読み込み失敗
+/// @note   旧形式は全パターン状態の評価値を1段階ぶん持つ
+///
+static bool load_legacy(Evaluator *eval, FILE *fp)
+{
+    int    *values = malloc(eval->num_index * sizeof(int));
+    int    *count  = calloc(eval->num_weights, sizeof(int));
+    double *sum    = calloc(eval->num_weights, sizeof(double));
+    bool   result  = false;
+
+    if (values && count && sum &&
+        (fread(values, sizeof(int), eval->num_index, fp) == (size_t)eval->num_index)) {
+        // 読み込んだ評価値を設定する
+        // 対称なパターン状態の評価値は平均して正規パターンの評価値とする
+        for (int i = 0; i < eval->num_index; i++) {
+            sum[eval->index_map[i]] += values[i];
+            count[eval->index_map[i]]++;
+        }
+        for (int i = 0; i < eval->num_weights; i++) {
+            eval->weights[i] = (int)(sum[i] / count[i]);
+        }
+        // 全段階で同じ評価値を使う
+        for (int i = 1; i < NUM_STAGE; i++) {
+            memcpy(&eval->weights[i * eval->num_weights], eval->weights, eval->num_weights * sizeof(int));
+        }
+        result = true;
+    }
+
+    free(sum);
+    free(count);
+    free(values);
+
+    return result;
 }
 
 bool Evaluator_save(Evaluator *eval, const char *file)
 {
-    FILE *fp = fopen(file, "wb");
+    // 書き込み途中の中断で評価値ファイルが壊れないよう、一時ファイルを置き換える
+    FILE *fp = SafeFile_open(file);
     if (!fp) {
         return false;
     }
 
-    for (int i = 0; i < NUM_PATTERN; i++) {
-        if (fwrite(eval->values[i], sizeof(int), pattern_size[i], fp) < (size_t)pattern_size[i]) {
-            fclose(fp);
-            return true;
+    // 識別子、形式バージョン、段階数、評価値数に続けて正規パターンの評価値を書き出す
+    int  header[3] = { EVAL_FILE_VERSION, NUM_STAGE, eval->num_weights };
+    bool result = (fwrite(EVAL_FILE_MAGIC, sizeof(EVAL_FILE_MAGIC) - 1, 1, fp) == 1) &&
+                  (fwrite(header, sizeof(int), 3, fp) == 3) &&
+                  (fwrite(eval->weights, sizeof(int), eval->num_weights * NUM_STAGE, fp) == (size_t)(eval->num_weights * NUM_STAGE));
+
+    return SafeFile_close(fp, file, result);
+}
+
+bool Evaluator_write_state(const Evaluator *eval, FILE *fp)
+{
+    // 段階数、評価値数、評価値、集計中の評価値位置の数に続けて、位置ごとに出現回数と差分の合計を書き出す
+    int  header[3] = { NUM_STAGE, eval->num_weights, eval->num_dirty };
+    bool result = (fwrite(header, sizeof(int), 3, fp) == 3) &&
+                  (fwrite(eval->weights, sizeof(int), eval->num_weights * NUM_STAGE, fp) == (size_t)(eval->num_weights * NUM_STAGE));
+
+    for (int i = 0; result && (i < eval->num_dirty); i++) {
+        int id = eval->dirty[i];
+        result = (fwrite(&id, sizeof(int), 1, fp) == 1) &&
+                 (fwrite(&eval->pattern_num[id], sizeof(int), 1, fp) == 1) &&
+                 (fwrite(&eval->pattern_sum[id], sizeof(double), 1, fp) == 1);
+    }
+
+    return result;
+}
+
+bool Evaluator_read_state(Evaluator *eval, FILE *fp)
+{
+    int  header[3];
+    bool result = (fread(header, sizeof(int), 3, fp) == 3) &&
+                  (header[0] == NUM_STAGE) &&
+                  (header[1] == eval->num_weights) &&
+                  (header[2] >= 0) && (header[2] <= (eval->num_weights * NUM_STAGE)) &&
+                  (fread(eval->weights, sizeof(int), eval->num_weights * NUM_STAGE, fp) == (size_t)(eval->num_weights * NUM_STAGE));
+
+    // 読み込み前の集計は破棄する
+    for (int i = 0; i < eval->num_dirty; i++) {
+        eval->pattern_num[eval->dirty[i]] = 0;
+        eval->pattern_sum[eval->dirty[i]] = 0;
+    }
+    eval->num_dirty = 0;
+
+    for (int i = 0; result && (i < header[2]); i++) {
+        int    id, num;
+        double sum;
+        result = (fread(&id, sizeof(int), 1, fp) == 1) &&
+                 (fread(&num, sizeof(int), 1, fp) == 1) &&
+                 (fread(&sum, sizeof(double), 1, fp) == 1) &&
+                 (id >= 0) && (id < (eval->num_weights * NUM_STAGE)) && (num > 0);
+        if (result) {
+            if (eval->pattern_num[id] == 0) {
+                eval->dirty[eval->num_dirty++] = id;
+            }
+            eval->pattern_num[id] += num;
+            eval->pattern_sum[id] += sum;
         }
     }
 
-    fclose(fp);
+    eval->version++;
 
-    return true;
+    return result;
 }
 
 int Evaluator_evaluate(Evaluator *eval, const Board *board)
 {
+    return eval->evaluate(eval, board);
+}
+
+bool Evaluator_set_kernel(Evaluator *eval, EvalKernel kernel)
+{
+    int (*evaluate)(const Evaluator *, const Board *) = NULL;
+
+    if (kernel != EVAL_KERNEL_AVX2) {
+        evaluate = evaluate_scalar;
+    }
+#ifdef USE_AVX2
+    __builtin_cpu_init();
+    if (((kernel == EVAL_KERNEL_AUTO) || (kernel == EVAL_KERNEL_AVX2)) && __builtin_cpu_supports("avx2")) {
+        evaluate = evaluate_avx2;
+    }
+#endif
+
+    if (!evaluate) {
+        return false;
+    }
+    eval->evaluate = evaluate;
+
+    return true;
+}
+
+///
+/// @fn     evaluate_scalar
+/// @brief  局面を評価する（スカラー版）
+/// @param[in]  eval    評価器
+/// @param[in]  board   盤面
+/// @return 局面の評価値
+///
+static int evaluate_scalar(const Evaluator *eval, const Board *board)
+{
+    const int *w = eval->weights + STAGE(Board_count_disks(board, EMPTY)) * eval->num_weights;
     int result = 0;
 
     // 各パターンの評価値総和を返す
-    result += eval->values[PATTERN_HV4][Board_pattern(board, PATTERN_ID_HV4_1)];
-    result += eval->values[PATTERN_HV4][Board_pattern(board, PATTERN_ID_HV4_2)];
-    result += eval->values[PATTERN_HV4][Board_pattern(board, PATTERN_ID_HV4_3)];
-    result += eval->values[PATTERN_HV4][Board_pattern(board, PATTERN_ID_HV4_4)];
-    result += eval->values[PATTERN_HV3][Board_pattern(board, PATTERN_ID_HV3_1)];
-    result += eval->values[PATTERN_HV3][Board_pattern(board, PATTERN_ID_HV3_2)];
-    result += eval->values[PATTERN_HV3][Board_pattern(board, PATTERN_ID_HV3_3)];
-    result += eval->values[PATTERN_HV3][Board_pattern(board, PATTERN_ID_HV3_4)];
-    result += eval->values[PATTERN_HV2][Board_pattern(board, PATTERN_ID_HV2_1)];
-    result += eval->values[PATTERN_HV2][Board_pattern(board, PATTERN_ID_HV2_2)];
-    result += eval->values[PATTERN_HV2][Board_pattern(board, PATTERN_ID_HV2_3)];
-    result += eval->values[PATTERN_HV2][Board_pattern(board, PATTERN_ID_HV2_4)];
-    result += eval->values[PATTERN_DIAG8][Board_pattern(board, PATTERN_ID_DIAG8_1)];
-    result += eval->values[PATTERN_DIAG8][Board_pattern(board, PATTERN_ID_DIAG8_2)];
-    result += eval->values[PATTERN_DIAG7][Board_pattern(board, PATTERN_ID_DIAG7_1)];
-    result += eval->values[PATTERN_DIAG7][Board_pattern(board, PATTERN_ID_DIAG7_2)];
-    result += eval->values[PATTERN_DIAG7][Board_pattern(board, PATTERN_ID_DIAG7_3)];
-    result += eval->values[PATTERN_DIAG7][Board_pattern(board, PATTERN_ID_DIAG7_4)];
-    result += eval->values[PATTERN_DIAG6][Board_pattern(board, PATTERN_ID_DIAG6_1)];
-    result += eval->values[PATTERN_DIAG6][Board_pattern(board, PATTERN_ID_DIAG6_2)];
-    result += eval->values[PATTERN_DIAG6][Board_pattern(board, PATTERN_ID_DIAG6_3)];
-    result += eval->values[PATTERN_DIAG6][Board_pattern(board, PATTERN_ID_DIAG6_4)];
-    result += eval->values[PATTERN_DIAG5][Board_pattern(board, PATTERN_ID_DIAG5_1)];
-    result += eval->values[PATTERN_DIAG5][Board_pattern(board, PATTERN_ID_DIAG5_2)];
-    result += eval->values[PATTERN_DIAG5][Board_pattern(board, PATTERN_ID_DIAG5_3)];
-    result += eval->values[PATTERN_DIAG5][Board_pattern(board, PATTERN_ID_DIAG5_4)];
-    result += eval->values[PATTERN_DIAG4][Board_pattern(board, PATTERN_ID_DIAG4_1)];
-    result += eval->values[PATTERN_DIAG4][Board_pattern(board, PATTERN_ID_DIAG4_2)];
-    result += eval->values[PATTERN_DIAG4][Board_pattern(board, PATTERN_ID_DIAG4_3)];
-    result += eval->values[PATTERN_DIAG4][Board_pattern(board, PATTERN_ID_DIAG4_4)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_1)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_2)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_3)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_4)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_5)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_6)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_7)];
-    result += eval->values[PATTERN_EDGE8][Board_pattern(board, PATTERN_ID_EDGE8_8)];
-    result += eval->values[PATTERN_CORNER8][Board_pattern(board, PATTERN_ID_CORNER8_1)];
-    result += eval->values[PATTERN_CORNER8][Board_pattern(board, PATTERN_ID_CORNER8_2)];
-    result += eval->values[PATTERN_CORNER8][Board_pattern(board, PATTERN_ID_CORNER8_3)];
-    result += eval->values[PATTERN_CORNER8][Board_pattern(board, PATTERN_ID_CORNER8_4)];
-    result += eval->values[PATTERN_PARITY][Board_count_disks(board, EMPTY) & 1];
+#define EVALUATE_PATTERN(name, type, ...) \
+    result += w[eval->map[PATTERN_##type][Board_pattern(board, PATTERN_ID_##name)]];
+    PATTERN_ID_LIST(EVALUATE_PATTERN)
+#undef EVALUATE_PATTERN
+    result += w[eval->map[PATTERN_PARITY][Board_count_disks(board, EMPTY) & 1]];
+
+    return result;
+}
+
+#ifdef USE_AVX2
+///
+/// @fn     evaluate_avx2
+/// @brief  局面を評価する（AVX2版）
+/// @param[in]  eval    評価器
+/// @param[in]  board   盤面
+/// @return 局面の評価値
+/// @note   パターン状態に変換表オフセットを加え、8パターンずつgatherで評価値位置・評価値を取得する
+///
+__attribute__((target("avx2")))
+static int evaluate_avx2(const Evaluator *eval, const Board *board)
+{
+    const int *index = Board_pattern_list(board);
+    const int *w = eval->weights + STAGE(Board_count_disks(board, EMPTY)) * eval->num_weights;
+    __m256i sum = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; (i + 8) <= NUM_PATTERN_ID; i += 8) {
+        __m256i id = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&index[i]),
+                                      _mm256_loadu_si256((const __m256i *)&eval->offset[i]));
+        // 変換表は16bit要素のため、32bit単位で読み出し下位16bitを取り出す
+        id  = _mm256_i32gather_epi32((const int *)eval->index_map, id, sizeof(unsigned short));
+        id  = _mm256_and_si256(id, _mm256_set1_epi32(0xFFFF));
+        sum = _mm256_add_epi32(sum, _mm256_i32gather_epi32(w, id, sizeof(int)));
+    }
+
+    // 水平加算
+    __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+    int result = _mm_cvtsi128_si32(sum4);
+
+    // 8パターンに満たない残り
+    for (; i < NUM_PATTERN_ID; i++) {
+        result += w[eval->index_map[eval->offset[i] + index[i]]];
+    }
+
+    result += w[eval->map[PATTERN_PARITY][Board_count_disks(board, EMPTY) & 1]];
 
     return result;
 }
+#endif
 
 ///
 /// @fn     add_pattern
 /// @brief  盤面パターンを追加する
 /// @param[in,out]  eval    評価器
-/// @param[in]      pattern パターン
-/// @param[in]      id      パターンID
-/// @param[in]      mirror  対称パターンの存在フラグ
+/// @param[in]      id      正規パターンの評価値位置（進行段階を含む）
 /// @param[in]      diff    評価値差分
+/// @param[in]      weight  局面の重み（同じ局面の出現回数）
+/// @note   対称なパターンは同じ評価値位置を共有するため、常に同じ値で更新される
 ///
-static void add_pattern(Evaluator* eval, int pattern, int id, int mirror, double diff)
+static void add_pattern(Evaluator* eval, int id, double diff, int weight)
 {
-    // パターンの出現数と評価値差分を加算
-    eval->pattern_num[pattern][id]++;
-    eval->pattern_sum[pattern][id] += diff;
-
-    // 対称なパターンも同様に操作する
-    if (mirror >= 0) {
-        eval->pattern_num[pattern][mirror] = eval->pattern_num[pattern][id];
-        eval->pattern_sum[pattern][mirror] = eval->pattern_sum[pattern][id];
+    // 初出の評価値位置を更新対象に加える
+    if (eval->pattern_num[id] == 0) {
+        eval->dirty[eval->num_dirty++] = id;
     }
+
+    // パターンの出現数と評価値差分を加算
+    eval->pattern_num[id] += weight;
+    eval->pattern_sum[id] += diff * weight;
 }
 
 void Evaluator_add(Evaluator *eval, const Board *board, int value)
 {
-    int index;
+    const int *index = Board_pattern_list(board);
+    int base = STAGE(Board_count_disks(board, EMPTY)) * eval->num_weights;
     double diff;
 
     // 局面評価値と評価器出力の差分をとり、更新のベースとする
     diff = (double)(value - Evaluator_evaluate(eval, board));
 
-    index = Board_pattern(board, PATTERN_ID_HV4_1);
-    add_pattern(eval, PATTERN_HV4, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV4_2);
-    add_pattern(eval, PATTERN_HV4, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV4_3);
-    add_pattern(eval, PATTERN_HV4, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV4_4);
-    add_pattern(eval, PATTERN_HV4, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV3_1);
-    add_pattern(eval, PATTERN_HV3, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV3_2);
-    add_pattern(eval, PATTERN_HV3, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV3_3);
-    add_pattern(eval, PATTERN_HV3, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV3_4);
-    add_pattern(eval, PATTERN_HV3, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV2_1);
-    add_pattern(eval, PATTERN_HV2, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV2_2);
-    add_pattern(eval, PATTERN_HV2, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV2_3);
-    add_pattern(eval, PATTERN_HV2, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_HV2_4);
-    add_pattern(eval, PATTERN_HV2, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG8_1);
-    add_pattern(eval, PATTERN_DIAG8, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG8_2);
-    add_pattern(eval, PATTERN_DIAG8, eval->mirror_line[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG7_1);
-    add_pattern(eval, PATTERN_DIAG7, eval->mirror_line[index * POW3_1], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG7_2);
-    add_pattern(eval, PATTERN_DIAG7, eval->mirror_line[index * POW3_1], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG7_3);
-    add_pattern(eval, PATTERN_DIAG7, eval->mirror_line[index * POW3_1], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG7_4);
-    add_pattern(eval, PATTERN_DIAG7, eval->mirror_line[index * POW3_1], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG6_1);
-    add_pattern(eval, PATTERN_DIAG6, eval->mirror_line[index * POW3_2], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG6_2);
-    add_pattern(eval, PATTERN_DIAG6, eval->mirror_line[index * POW3_2], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG6_3);
-    add_pattern(eval, PATTERN_DIAG6, eval->mirror_line[index * POW3_2], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG6_4);
-    add_pattern(eval, PATTERN_DIAG6, eval->mirror_line[index * POW3_2], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG5_1);
-    add_pattern(eval, PATTERN_DIAG5, eval->mirror_line[index * POW3_3], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG5_2);
-    add_pattern(eval, PATTERN_DIAG5, eval->mirror_line[index * POW3_3], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG5_3);
-    add_pattern(eval, PATTERN_DIAG5, eval->mirror_line[index * POW3_3], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG5_4);
-    add_pattern(eval, PATTERN_DIAG5, eval->mirror_line[index * POW3_3], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG4_1);
-    add_pattern(eval, PATTERN_DIAG4, eval->mirror_line[index * POW3_4], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG4_2);
-    add_pattern(eval, PATTERN_DIAG4, eval->mirror_line[index * POW3_4], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG4_3);
-    add_pattern(eval, PATTERN_DIAG4, eval->mirror_line[index * POW3_4], index, diff);
-    index = Board_pattern(board, PATTERN_ID_DIAG4_4);
-    add_pattern(eval, PATTERN_DIAG4, eval->mirror_line[index * POW3_4], index, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_1);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_2);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_3);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_4);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_5);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_6);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_7);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_EDGE8_8);
-    add_pattern(eval, PATTERN_EDGE8, index, -1, diff);
-    index = Board_pattern(board, PATTERN_ID_CORNER8_1);
-    add_pattern(eval, PATTERN_CORNER8, eval->mirror_corner[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_CORNER8_2);
-    add_pattern(eval, PATTERN_CORNER8, eval->mirror_corner[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_CORNER8_3);
-    add_pattern(eval, PATTERN_CORNER8, eval->mirror_corner[index], index, diff);
-    index = Board_pattern(board, PATTERN_ID_CORNER8_4);
-    add_pattern(eval, PATTERN_CORNER8, eval->mirror_corner[index], index, diff);
-
-    add_pattern(eval, PATTERN_PARITY, (Board_count_disks(board, EMPTY) & 1), -1, diff);
+    for (int i = 0; i < NUM_PATTERN_ID; i++) {
+        add_pattern(eval, base + eval->index_map[eval->offset[i] + index[i]], diff, 1);
+    }
+
+    add_pattern(eval, base + eval->map[PATTERN_PARITY][Board_count_disks(board, EMPTY) & 1], diff, 1);
+}
+
+double Evaluator_add_sample(Evaluator *eval, const uint16_t *index, int empties, double value, int weight)
+{
+    int features[NUM_FEATURE];
+    int result = 0;
+
+    Evaluator_features(eval, index, empties, features);
+    for (int i = 0; i < NUM_FEATURE; i++) {
+        result += eval->weights[features[i]];
+    }
+
+    // 局面評価値と評価器出力の差分をとり、出現回数ぶんまとめて加算する
+    double diff = value - result;
+    for (int i = 0; i < NUM_FEATURE; i++) {
+        add_pattern(eval, features[i], diff, weight);
+    }
+
+    return diff;
 }
 
 ///
 /// @fn     update_pattern
 /// @brief  盤面パターンを更新する
 /// @param[in,out]  eval    評価器
-/// @param[in]      pattern パターン
-/// @param[in]      id      パターンID
+/// @param[in]      id      正規パターンの評価値位置（進行段階を含む）
+/// @retval true    評価値が変化した
+/// @retval false   評価値が変化しなかった
 ///
-static void update_pattern(Evaluator *eval, int pattern, int id)
+static bool update_pattern(Evaluator *eval, int id)
 {
     int diff;
+    int prev = eval->weights[id];
 
     // 出現回数超えるパターンを更新
-    if (eval->pattern_num[pattern][id] > MIN_FREQUNECY) {
+    if (eval->pattern_num[id] > MIN_FREQUNECY) {
         // 評価値更新差分: （評価値差分総和）/（パターン出現回数）*（更新率）
-        diff = (int)(eval->pattern_sum[pattern][id] / eval->pattern_num[pattern][id] * UPDATE_RATIO);
+        diff = (int)(eval->pattern_sum[id] / eval->pattern_num[id] * UPDATE_RATIO);
 
         // 評価値を -MAX_PATTERN_VALUE <= n <= MAX_PATTERN_VALUE の範囲に制限する
-        if ((MAX_PATTERN_VALUE - diff) < eval->values[pattern][id]) {
-            eval->values[pattern][id] = MAX_PATTERN_VALUE;
-        } else if ((-MAX_PATTERN_VALUE - diff) > eval->values[pattern][id]) {
-            eval->values[pattern][id] = -MAX_PATTERN_VALUE;
+        if ((MAX_PATTERN_VALUE - diff) < eval->weights[id]) {
+            eval->weights[id] = MAX_PATTERN_VALUE;
+        } else if ((-MAX_PATTERN_VALUE - diff) > eval->weights[id]) {
+            eval->weights[id] = -MAX_PATTERN_VALUE;
         } else {
-            eval->values[pattern][id] += diff;
+            eval->weights[id] += diff;
         }
 
-        eval->pattern_num[pattern][id] = 0;
-        eval->pattern_sum[pattern][id] = 0;
+        eval->pattern_num[id] = 0;
+        eval->pattern_sum[id] = 0;
     }
+
+    return (eval->weights[id] != prev);
 }
 
-void Evaluator_update(Evaluator *eval)
+int Evaluator_update(Evaluator *eval)
 {
-    for (int i = 0; i < NUM_PATTERN; i++) {
-        for (int j = 0; j < pattern_size[i]; j++) {
-            update_pattern(eval, i, j);
+    int changed = 0;
+    int num = 0;
+
+    // 登録された評価値位置のみ走査し、出現回数の足りないものは次回へ残す
+    for (int i = 0; i < eval->num_dirty; i++) {
+        int id = eval->dirty[i];
+        if (update_pattern(eval, id)) {
+            changed++;
+        }
+        if (eval->pattern_num[id] > 0) {
+            eval->dirty[num++] = id;
         }
     }
+    eval->num_dirty = num;
+
+    eval->version++;
+
+    return changed;
+}
+
+void Evaluator_merge(Evaluator *eval, Evaluator *fork)
+{
+    for (int i = 0; i < fork->num_dirty; i++) {
+        int id = fork->dirty[i];
+        if (eval->pattern_num[id] == 0) {
+            eval->dirty[eval->num_dirty++] = id;
+        }
+        eval->pattern_num[id] += fork->pattern_num[id];
+        eval->pattern_sum[id] += fork->pattern_sum[id];
+        fork->pattern_num[id] = 0;
+        fork->pattern_sum[id] = 0;
+    }
+    fork->num_dirty = 0;
+}
+
+int Evaluator_version(const Evaluator *eval)
+{
+    return (eval->parent ? eval->parent->version : eval->version);
+}
+
+int Evaluator_num_weights(const Evaluator *eval)
+{
+    return eval->num_weights * NUM_STAGE;
+}
+
+void Evaluator_features(const Evaluator *eval, const uint16_t *index, int empties, int *features)
+{
+    int base = STAGE(empties) * eval->num_weights;
+
+    for (int i = 0; i < NUM_PATTERN_ID; i++) {
+        features[i] = base + eval->index_map[eval->offset[i] + index[i]];
+    }
+    features[NUM_PATTERN_ID] = base + eval->map[PATTERN_PARITY][empties & 1];
+}
+
+void Evaluator_get_weights(const Evaluator *eval, double *weights)
+{
+    for (int i = 0; i < (eval->num_weights * NUM_STAGE); i++) {
+        weights[i] = eval->weights[i];
+    }
+}
+
+void Evaluator_set_weights(Evaluator *eval, const double *weights)
+{
+    for (int i = 0; i < (eval->num_weights * NUM_STAGE); i++) {
+        // 評価値を -MAX_PATTERN_VALUE <= n <= MAX_PATTERN_VALUE の範囲に制限する
+        if (weights[i] > MAX_PATTERN_VALUE) {
+            eval->weights[i] = MAX_PATTERN_VALUE;
+        } else if (weights[i] < -MAX_PATTERN_VALUE) {
+            eval->weights[i] = -MAX_PATTERN_VALUE;
+        } else {
+            eval->weights[i] = (int)((weights[i] < 0) ? (weights[i] - 0.5) : (weights[i] + 0.5));
+        }
+    }
+
+    eval->version++;
 }
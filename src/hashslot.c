@@ -0,0 +1,40 @@
+///
+/// @file   hashslot.c
+/// @brief  複数スレッドから参照・登録できるハッシュ表のエントリ
+/// @author kentakuramochi
+///
+
+#include "hashslot.h"
+
+#include <stdlib.h>
+
+HashSlot *HashSlot_create(int size, uint64_t *mask)
+{
+    if (size <= 0) {
+        return NULL;
+    }
+
+    // エントリ数を2の冪乗に切り下げる
+    uint64_t num = 1;
+    while ((num << 1) <= (uint64_t)size) {
+        num <<= 1;
+    }
+
+    HashSlot *slots = malloc(num * sizeof(HashSlot));
+    if (!slots) {
+        return NULL;
+    }
+    *mask = num - 1;
+
+    HashSlot_clear(slots, *mask);
+
+    return slots;
+}
+
+void HashSlot_clear(HashSlot *slots, uint64_t mask)
+{
+    for (uint64_t i = 0; i <= mask; i++) {
+        atomic_store_explicit(&slots[i].data, HASHSLOT_EMPTY, memory_order_relaxed);
+        atomic_store_explicit(&slots[i].check, 0, memory_order_relaxed);
+    }
+}
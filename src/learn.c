@@ -4,118 +4,1079 @@
 /// @author kentakuramochi
 ///
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "learn.h"
+#include "record.h"
+#include "dataset.h"
+#include "random.h"
+#include "safefile.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+///
+/// @def    UPDATE_INTERVAL
+/// @brief  評価パラメータを更新する対局数
+///
+#define UPDATE_INTERVAL 10
+
+///
+/// @def    SAVE_INTERVAL
+/// @brief  評価パラメータを保存する対局数
+///
+#define SAVE_INTERVAL 100
+
+///
+/// @def    CHECKPOINT_MAGIC
+/// @brief  学習の途中経過ファイルの識別子
+///
+#define CHECKPOINT_MAGIC "RVCP"
+
+///
+/// @def    CHECKPOINT_VERSION
+/// @brief  学習の途中経過ファイルの形式バージョン
+///
+#define CHECKPOINT_VERSION 1
+
+///
+/// @def    MAX_SAMPLES
+/// @brief  棋譜からの学習で評価器へ登録する前にまとめる学習局面数の上限
+///
+#define MAX_SAMPLES (1 << 18)
+
+///
+/// @struct Sample
+/// @brief  重複をまとめた学習局面
+///
+typedef struct {
+    uint64_t     hash;      ///< 対称変換によらないハッシュ値
+    double       sum;       ///< 石数差の合計
+    DatasetEntry entry;     ///< 局面（最初に出現したもの、出現回数を持つ）
+} Sample;
 
-static int get_rand(int max);
+///
+/// @struct SampleTable
+/// @brief  評価器へ登録する前の学習局面の集計表
+/// @note   対称な局面を含む同じ局面は、出現回数と石数差の平均をもつ1局面にまとめる
+///
+typedef struct {
+    Sample  *samples;   ///< 学習局面（出現順）
+    int     *slots;     ///< ハッシュ値から学習局面への索引（-1は空き）
+    int     size;       ///< 索引の大きさ（2の冪乗）
+    int     num;        ///< 学習局面数
+    double  error;      ///< 登録時の評価値の絶対誤差の合計（出現回数で重み付け）
+    double  weight;     ///< 登録した局面の出現回数の合計
+} SampleTable;
+
+///
+/// @struct Checkpoint
+/// @brief  自己対局の途中経過
+/// @note   対局の乱数系列はシードと対局番号から定まるため、乱数生成器の状態はこの2つで復元できる
+///         学習するときは評価値と学習用の集計をあわせて保存する
+///         評価値を更新する対局数はスレッド数によらないため、スレッド数は保存せず、異なるスレッド数でも再開できる
+///
+typedef struct {
+    int32_t  learning;      ///< 学習するか（0: 棋譜の保存のみ）
+    int32_t  games;         ///< 終えた対局数
+    uint64_t seed;          ///< 乱数シード
+    int64_t  store_size;    ///< 棋譜の保存先のバイト数
+} Checkpoint;
+
+///
+/// @struct Metrics
+/// @brief  学習の進捗の集計
+/// @note   評価値の保存ごとに集計し、計測ファイルへ1行ずつ書き出す
+///
+typedef struct {
+    int     games;      ///< 対局数
+    long    positions;  ///< 学習局面数（重複をまとめる前）
+    double  error;      ///< 評価値の絶対誤差の合計（出現回数で重み付け）
+    double  weight;     ///< 登録した局面の出現回数の合計
+    int     changed;    ///< 更新した評価値の数
+    double  search;     ///< 対局にかかった時間[s]（全スレッド合計）
+    double  update;     ///< 評価値の集約・更新にかかった時間[s]
+    double  start;      ///< 集計開始時刻[s]
+    unsigned long long mid_nodes;   ///< 集計開始時の中盤探索ノード数
+    unsigned long long end_nodes;   ///< 集計開始時の終盤探索ノード数
+} Metrics;
+
+///
+/// @struct Worker
+/// @brief  自己対局スレッド
+///
+/// @note   対局ごとに乱数系列を定め、評価値の更新までの対局数をスレッド数によらず一定とし、
+///         学習局面は更新時に対局番号順に集計するため、同じシードからはスレッド数によらず同じ対局・学習結果となる
+///
+typedef struct {
+    Board       *board;     ///< 盤面
+    Com         *com;       ///< COM思考ルーチン（評価値は共有）
+    Random      random;     ///< 乱数生成器
+    Record      records[UPDATE_INTERVAL];   ///< 今回の更新までの棋譜
+    int         index;      ///< スレッド番号
+    int         threads;    ///< スレッド数
+    int         first;      ///< 今回の更新の最初の対局番号
+    int         games;      ///< 今回の更新までの対局数（全スレッド合計）
+    long        positions;  ///< 今回の更新までの学習局面数
+    double      search;     ///< 今回の更新までの対局にかかった時間[s]
+    uint64_t    seed;       ///< シード
+    pthread_t   thread;     ///< スレッド
+    bool        running;    ///< スレッド実行中フラグ
+} Worker;
+
+static double now(void);
+static int move_random(Board *board, const int color, Random *random);
+
+static void play_game(Worker *worker, Record *record);
+static bool init_samples(SampleTable *table, int capacity);
+static void free_samples(SampleTable *table);
+static void flush_samples(SampleTable *table, Evaluator *evaluator);
+static void add_positions(SampleTable *table, Evaluator *evaluator, Board *board, const int *colors, int num);
+
+static void *run_worker(void *arg);
+
+static bool save_checkpoint(const char *file, Checkpoint *checkpoint, const Evaluator *evaluator, FILE *store);
+static bool load_checkpoint(const char *file, Checkpoint *checkpoint, Evaluator *evaluator);
+static bool resume(const char *file, Checkpoint *checkpoint, Evaluator *evaluator, FILE *store);
+
+static bool is_csv(const char *file);
+static FILE *open_metrics(const char *file);
+static void begin_metrics(Metrics *metrics, const Worker *workers, int threads);
+static void write_metrics(FILE *fp, bool csv, const Metrics *metrics, const Worker *workers, int threads, int total);
+static void run_learning(Evaluator *evaluator, Worker *workers, FILE *store, FILE *metrics, Checkpoint *checkpoint, const LearnSetting *setting);
+
+///
+/// @struct Trainer
+/// @brief  データセット学習スレッド
+///
+typedef struct Trainer_ {
+    const Evaluator *evaluator; ///< 評価器（評価値位置の変換のみ）
+    const Dataset   *dataset;   ///< データセット
+    double      *weights;       ///< 評価値（全スレッド共有）
+    double      *grad;          ///< 勾配（スレッドごと）
+    int         *count;         ///< 評価値の出現回数（スレッドごと）
+    size_t      begin;          ///< 担当する局面の先頭
+    size_t      end;            ///< 担当する局面の末尾の次
+    int         first;          ///< 集約を担当する評価値の先頭
+    int         last;           ///< 集約を担当する評価値の末尾の次
+    double      loss;           ///< 二乗誤差の合計
+    double      weight;         ///< 局面の出現回数の合計
+    double      rate;           ///< 学習率
+    struct Trainer_ *all;       ///< 全スレッド
+    int         threads;        ///< スレッド数
+    pthread_t   thread;         ///< スレッド
+    bool        running;        ///< スレッド実行中フラグ
+} Trainer;
 
-static void move_random(Board *board, const int color);
+static void *run_gradient(void *arg);
+static void *run_reduce(void *arg);
+static void run_trainers(Trainer *trainers, int threads, void *(*func)(void *));
 
 ///
-/// @fn     get_rand
-/// @brief  指定した値未満の整数乱数を取得する
-/// @param[in]  max 乱数上限値 (0 <= rand < max)
+/// @fn     now
+/// @brief  経過時間の計測用の時刻を取得する
+/// @return 時刻[s]
 ///
-static int get_rand(int max)
+static double now(void)
 {
-    return (int)((double)max * rand() / (RAND_MAX + 1.0));
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
 ///
 /// @fn     move_random
-/// @brief  ランダムな位置に着手する
+/// @brief  有効手から一様にランダムに選んで着手する
 /// @param[in,out]  board   盤面
 /// @param[in]      color   手番色
+/// @param[in,out]  random  乱数生成器
+/// @return 着手座標
+///
+static int move_random(Board *board, const int color, Random *random)
+{
+    uint64_t moves = Board_legal_moves(board, color);
+    int num = 0;
+
+    for (uint64_t m = moves; m; m &= (m - 1)) {
+        num++;
+    }
+
+    // n番目の有効手を選ぶ
+    for (int n = Random_int(random, num); n > 0; n--) {
+        moves &= (moves - 1);
+    }
+
+    int bit = 0;
+    while (!((moves >> bit) & 1)) {
+        bit++;
+    }
+
+    int pos = Board_pos(bit % BOARD_SIZE, bit / BOARD_SIZE);
+    Board_flip(board, color, pos);
+
+    return pos;
+}
+
+///
+/// @fn     play_game
+/// @brief  1局自己対局する
+/// @param[in,out]  worker  自己対局スレッド
+/// @param[out]     record  棋譜
+///
+static void play_game(Worker *worker, Record *record)
+{
+    Board *board = worker->board;
+
+    Board_init(board);
+    Record_init(record);
+
+    int color = BLACK;
+    int move;
+    int value;
+
+    // 初期8手はランダムに着手する
+    for (int j = 0; j < 8; j++) {
+        if (Board_can_play(board, color)) {
+            Record_add(record, move_random(board, color, &worker->random));
+        }
+        color = Board_opponent(color);
+    }
+
+    while (true) {
+        if (Board_can_play(board, color)) {
+            // ランダム着手: 空きマス12以上のとき、1%の確率
+            if ((Board_count_disks(board, EMPTY) > 12) && (Random_int(&worker->random, 100) < 1)) {
+                move = move_random(board, color, &worker->random);
+            } else {
+                move = Com_get_nextmove(worker->com, board, color, &value);
+                Board_flip(board, color, move);
+            }
+            Record_add(record, move);
+        } else if (!Board_can_play(board, Board_opponent(color))){
+            break;
+        }
+        color = Board_opponent(color);
+    }
+
+    record->result = Board_count_disks(board, BLACK) - Board_count_disks(board, WHITE);
+}
+
+///
+/// @fn     init_samples
+/// @brief  学習局面の集計表を生成する
+/// @param[out] table       集計表
+/// @param[in]  capacity    まとめる学習局面数の上限
+/// @retval true    生成成功
+/// @retval false   メモリ確保失敗
 ///
-static void move_random(Board *board, const int color)
+static bool init_samples(SampleTable *table, int capacity)
 {
-    while (!Board_flip(board, color, Board_pos(get_rand(BOARD_SIZE), get_rand(BOARD_SIZE))));
+    // 負荷率1/2以下となる索引の大きさ
+    table->size = 1;
+    while (table->size < (capacity * 2)) {
+        table->size <<= 1;
+    }
+    table->num     = 0;
+    table->error   = 0;
+    table->weight  = 0;
+    table->samples = malloc((table->size / 2) * sizeof(Sample));
+    table->slots   = malloc(table->size * sizeof(int));
+    if (!table->samples || !table->slots) {
+        return false;
+    }
+
+    memset(table->slots, 0xFF, table->size * sizeof(int));
+
+    return true;
 }
 
-void learn(Board *board, Evaluator *evaluator, Com *com, const int iteration, const char* file)
+///
+/// @fn     free_samples
+/// @brief  学習局面の集計表を破棄する
+/// @param[in,out]  table   集計表
+///
+static void free_samples(SampleTable *table)
 {
-    // 着手履歴
-    int  history[BOARD_SIZE * BOARD_SIZE];
+    free(table->samples);
+    free(table->slots);
+    table->samples = NULL;
+    table->slots   = NULL;
+}
+
+///
+/// @fn     flush_samples
+/// @brief  まとめた学習局面を評価器へ登録し、集計表を空にする
+/// @param[in,out]  table       集計表
+/// @param[in,out]  evaluator   評価器
+///
+static void flush_samples(SampleTable *table, Evaluator *evaluator)
+{
+    for (int i = 0; i < table->num; i++) {
+        Sample *sample = &table->samples[i];
+        // 評価値: 終局時の石数差の平均
+        double diff = Evaluator_add_sample(evaluator, sample->entry.index, sample->entry.empties,
+                                           sample->sum / sample->entry.weight * DISK_VALUE, sample->entry.weight);
+        table->error  += ((diff < 0) ? -diff : diff) * sample->entry.weight;
+        table->weight += sample->entry.weight;
+    }
+
+    if (table->num > 0) {
+        memset(table->slots, 0xFF, table->size * sizeof(int));
+        table->num = 0;
+    }
+}
+
+///
+/// @fn     add_positions
+/// @brief  終局した対局の局面を学習局面へ加える
+/// @param[in,out]  table       集計表
+/// @param[in,out]  evaluator   評価器（集計表があふれたとき登録する）
+/// @param[in,out]  board       終局時の盤面（着手をすべて戻した盤面となる）
+/// @param[in]      colors      各着手の手番色
+/// @param[in]      num         着手数
+/// @note   評価値は進行段階ごとに持つため、終盤を含む全局面を加える
+///
+static void add_positions(SampleTable *table, Evaluator *evaluator, Board *board, const int *colors, int num)
+{
+    DatasetEntry entries[MAX_RECORD_MOVES];
+    uint64_t     hashes[MAX_RECORD_MOVES];
+
+    // 局面は黒番に揃えて取り出される
+    Dataset_extract(board, colors, num, entries, hashes);
+
+    for (int i = 0; i < num; i++) {
+        if (table->num >= (table->size / 2)) {
+            flush_samples(table, evaluator);
+        }
+
+        int slot = (int)(hashes[i] & (uint64_t)(table->size - 1));
+        while ((table->slots[slot] >= 0) && (table->samples[table->slots[slot]].hash != hashes[i])) {
+            slot = (slot + 1) & (table->size - 1);
+        }
+
+        if (table->slots[slot] < 0) {
+            // 初出の局面
+            table->slots[slot] = table->num;
+            table->samples[table->num].hash  = hashes[i];
+            table->samples[table->num].sum   = entries[i].result;
+            table->samples[table->num].entry = entries[i];
+            table->num++;
+        } else {
+            // 同じ局面: 出現回数と石数差を加える
+            Sample *sample = &table->samples[table->slots[slot]];
+            sample->sum += entries[i].result;
+            sample->entry.weight++;
+        }
+    }
+}
+
+///
+/// @fn     run_worker
+/// @brief  割り当てられた対局を自己対局する
+/// @param[in,out]  arg     自己対局スレッド (Worker *)
+/// @return NULL
+/// @note   スレッドiは今回の対局のうち i, i + スレッド数, ... 番目を担当する
+///
+static void *run_worker(void *arg)
+{
+    Worker *worker = arg;
+
+    for (int i = worker->index; i < worker->games; i += worker->threads) {
+        Random_init(&worker->random, Random_seed(worker->seed, (uint64_t)(worker->first + i)));
+
+        double start = now();
+        play_game(worker, &worker->records[i / worker->threads]);
+        worker->search    += now() - start;
+        worker->positions += worker->records[i / worker->threads].num;
+    }
+
+    return NULL;
+}
+
+void learn(Evaluator *evaluator, Com *com, const LearnSetting *setting)
+{
+    int        threads = setting->threads;
+    Worker     *workers = calloc(threads, sizeof(Worker));
+    FILE       *store = NULL;
+    FILE       *metrics = NULL;
+    bool       ready = (workers != NULL);
+    Checkpoint checkpoint = { (setting->game_file == NULL), 0, setting->seed, 0 };
+    const char *store_file = setting->game_file ? setting->game_file : setting->record_file;
+
+    // 対局の保存先・棋譜ファイルは追記する
+    if (ready && store_file) {
+        store = fopen(store_file, "ab");
+        if (!store) {
+            printf("failed to open %s\n", store_file);
+            ready = false;
+        }
+    }
+
+    // 途中経過から再開する: 評価値・集計・シード・対局数を復元する
+    if (ready && setting->resume) {
+        ready = resume(setting->checkpoint_file, &checkpoint, evaluator, store);
+    }
+
+    // 計測ファイルは追記する
+    if (ready && setting->metrics_file) {
+        metrics = open_metrics(setting->metrics_file);
+        if (!metrics) {
+            printf("failed to open %s\n", setting->metrics_file);
+            ready = false;
+        }
+    }
 
     // 探索深さは適当
     // 中盤: 4手読み、終盤: 12手読み
     Com_set_level(com, 4, 12, 12);
+    // 予算を指定したときは、上の深さを上限に予算内で探索する
+    Com_set_budget(com, setting->node_budget, setting->time_budget);
+
+    // スレッドごとに盤面・COM・乱数・学習の集計を持つ
+    for (int i = 0; ready && (i < threads); i++) {
+        workers[i].board     = Board_create();
+        workers[i].com       = Com_clone(com);
+        workers[i].index     = i;
+        workers[i].threads   = threads;
+        workers[i].seed      = checkpoint.seed;
+        ready = (workers[i].board && workers[i].com);
+        if (!ready) {
+            printf("failed to create workers\n");
+        }
+    }
+
+    if (ready) {
+        run_learning(evaluator, workers, store, metrics, &checkpoint, setting);
+    }
+
+    for (int i = 0; workers && (i < threads); i++) {
+        if (workers[i].com) {
+            Com_delete(workers[i].com);
+        }
+        if (workers[i].board) {
+            Board_delete(workers[i].board);
+        }
+    }
+    free(workers);
+
+    if (store) {
+        fclose(store);
+    }
+    if (metrics) {
+        fclose(metrics);
+    }
+}
+
+///
+/// @fn     save_checkpoint
+/// @brief  自己対局の途中経過を保存する
+/// @param[in]      file        途中経過ファイル名
+/// @param[in,out]  checkpoint  途中経過（棋譜の保存先のバイト数を更新する）
+/// @param[in]      evaluator   評価器（学習しないときは使わない）
+/// @param[in,out]  store       棋譜の保存先（-g・--recordで指定した棋譜ファイル、なければNULL）
+/// @retval true    保存成功
+/// @retval false   保存失敗（以前の途中経過が残る）
+/// @note   棋譜はディスクへ書き込んでから、そのバイト数を途中経過に記録する
+///
+static bool save_checkpoint(const char *file, Checkpoint *checkpoint, const Evaluator *evaluator, FILE *store)
+{
+    if (store) {
+        if (!SafeFile_sync(store)) {
+            return false;
+        }
+        checkpoint->store_size = ftell(store);
+    }
+
+    FILE *fp = SafeFile_open(file);
+    if (!fp) {
+        return false;
+    }
+
+    // 識別子、形式バージョン、途中経過に続けて、学習するときは評価値と集計を書き出す
+    int32_t version = CHECKPOINT_VERSION;
+    bool    result = (fwrite(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1, 1, fp) == 1) &&
+                     (fwrite(&version, sizeof(int32_t), 1, fp) == 1) &&
+                     (fwrite(checkpoint, sizeof(Checkpoint), 1, fp) == 1) &&
+                     (!checkpoint->learning || Evaluator_write_state(evaluator, fp));
+
+    return SafeFile_close(fp, file, result);
+}
+
+///
+/// @fn     load_checkpoint
+/// @brief  自己対局の途中経過を読み込む
+/// @param[in]      file        途中経過ファイル名
+/// @param[in,out]  checkpoint  途中経過（学習するかは呼び出し側で設定しておき、一致を確認する）
+/// @param[in,out]  evaluator   評価器（学習するとき評価値と集計を復元する）
+/// @retval true    読み込み成功
+/// @retval false   読み込み失敗
+///
+static bool load_checkpoint(const char *file, Checkpoint *checkpoint, Evaluator *evaluator)
+{
+    FILE *fp = fopen(file, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    char       magic[sizeof(CHECKPOINT_MAGIC) - 1];
+    int32_t    version;
+    Checkpoint saved;
+    bool       result = (fread(magic, sizeof(magic), 1, fp) == 1) &&
+                        (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0) &&
+                        (fread(&version, sizeof(int32_t), 1, fp) == 1) &&
+                        (version == CHECKPOINT_VERSION) &&
+                        (fread(&saved, sizeof(Checkpoint), 1, fp) == 1) &&
+                        (saved.learning == checkpoint->learning) &&
+                        (saved.games >= 0) && (saved.store_size >= 0) &&
+                        (!saved.learning || Evaluator_read_state(evaluator, fp));
+
+    fclose(fp);
+
+    if (result) {
+        *checkpoint = saved;
+    }
+
+    return result;
+}
 
-    printf("Start learning\n");
+///
+/// @fn     resume
+/// @brief  途中経過から自己対局を再開する準備をする
+/// @param[in]      file        途中経過ファイル名
+/// @param[in,out]  checkpoint  途中経過
+/// @param[in,out]  evaluator   評価器
+/// @param[in,out]  store       棋譜の保存先（-g・--recordで指定した棋譜ファイル、なければNULL）
+/// @retval true    再開できる（途中経過がないときは最初から対局する）
+/// @retval false   途中経過が壊れている、または棋譜の保存先が途中経過より短い
+/// @note   途中経過の保存後に追記された棋譜は、再開後に同じ対局をやり直すため切り詰める
+///
+static bool resume(const char *file, Checkpoint *checkpoint, Evaluator *evaluator, FILE *store)
+{
+    FILE *fp = fopen(file, "rb");
+    if (!fp) {
+        printf("no checkpoint in %s, start from the beginning\n", file);
+        return true;
+    }
+    fclose(fp);
+
+    if (!load_checkpoint(file, checkpoint, evaluator)) {
+        printf("failed to resume from %s\n", file);
+        return false;
+    }
+
+    if (store) {
+        if ((fseek(store, 0, SEEK_END) != 0) || (ftell(store) < checkpoint->store_size) ||
+            !SafeFile_truncate(store, checkpoint->store_size)) {
+            printf("game file is inconsistent with %s\n", file);
+            return false;
+        }
+    }
+
+    printf("Resume from game %d\n", checkpoint->games);
+
+    return true;
+}
+
+///
+/// @fn     is_csv
+/// @brief  ファイル名の拡張子がCSVか判定する
+/// @param[in]  file    ファイル名
+/// @retval true    拡張子が.csv
+/// @retval false   それ以外
+///
+static bool is_csv(const char *file)
+{
+    size_t len = strlen(file);
+
+    return (len >= 4) && (strcmp(file + len - 4, ".csv") == 0);
+}
+
+///
+/// @fn     open_metrics
+/// @brief  計測ファイルを追記用に開く
+/// @param[in]  file    ファイル名
+/// @return 計測ファイル（失敗時はNULL）
+/// @note   CSV形式で空のファイルのときは見出し行を書き出す
+///
+static FILE *open_metrics(const char *file)
+{
+    FILE *fp = fopen(file, "a");
+    if (!fp) {
+        return NULL;
+    }
+
+    if (is_csv(file) && (fseek(fp, 0, SEEK_END) == 0) && (ftell(fp) == 0)) {
+        fprintf(fp, "games,interval_games,elapsed,games_per_sec,positions_per_sec,"
+                    "mid_nodes_per_sec,end_nodes_per_sec,mae,weights_updated,"
+                    "search_time,update_time\n");
+    }
+
+    return fp;
+}
+
+///
+/// @fn     begin_metrics
+/// @brief  学習の進捗の集計を始める
+/// @param[out] metrics 集計
+/// @param[in]  workers 自己対局スレッド
+/// @param[in]  threads スレッド数
+///
+static void begin_metrics(Metrics *metrics, const Worker *workers, int threads)
+{
+    memset(metrics, 0, sizeof(Metrics));
+    metrics->start = now();
+
+    for (int i = 0; i < threads; i++) {
+        unsigned long long mid, end;
+        Com_count_total_nodes(workers[i].com, &mid, &end);
+        metrics->mid_nodes += mid;
+        metrics->end_nodes += end;
+    }
+}
+
+///
+/// @fn     write_metrics
+/// @brief  学習の進捗を計測ファイルへ1行書き出す
+/// @param[in]  fp      計測ファイル
+/// @param[in]  csv     CSV形式で書き出すか（falseのときJSON Lines形式）
+/// @param[in]  metrics 集計
+/// @param[in]  workers 自己対局スレッド
+/// @param[in]  threads スレッド数
+/// @param[in]  total   これまでの対局数
+/// @note   毎秒の値は経過時間あたり、探索・更新時間は集計期間の合計
+///
+static void write_metrics(FILE *fp, bool csv, const Metrics *metrics, const Worker *workers, int threads, int total)
+{
+    unsigned long long mid_nodes = 0, end_nodes = 0;
+    for (int i = 0; i < threads; i++) {
+        unsigned long long mid, end;
+        Com_count_total_nodes(workers[i].com, &mid, &end);
+        mid_nodes += mid;
+        end_nodes += end;
+    }
+    mid_nodes -= metrics->mid_nodes;
+    end_nodes -= metrics->end_nodes;
+
+    double elapsed = now() - metrics->start;
+    if (elapsed <= 0) {
+        elapsed = 1e-9;
+    }
+    // 平均絶対誤差は石数差で表す
+    double mae = (metrics->weight > 0) ? (metrics->error / metrics->weight / DISK_VALUE) : 0;
+
+    fprintf(fp, csv ? "%d,%d,%.3f,%.2f,%.1f,%.0f,%.0f,%.4f,%d,%.3f,%.3f\n" :
+                "{\"games\":%d,\"interval_games\":%d,\"elapsed\":%.3f,"
+                "\"games_per_sec\":%.2f,\"positions_per_sec\":%.1f,"
+                "\"mid_nodes_per_sec\":%.0f,\"end_nodes_per_sec\":%.0f,"
+                "\"mae\":%.4f,\"weights_updated\":%d,"
+                "\"search_time\":%.3f,\"update_time\":%.3f}\n",
+            total, metrics->games, elapsed,
+            metrics->games / elapsed, metrics->positions / elapsed,
+            mid_nodes / elapsed, end_nodes / elapsed,
+            mae, metrics->changed, metrics->search, metrics->update);
+    fflush(fp);
+}
 
-    for (int i = 0; i < iteration; i++) {
-        Board_init(board);
+///
+/// @fn     run_learning
+/// @brief  自己対局スレッドで対局し評価値を更新する
+/// @param[in,out]  evaluator   評価器
+/// @param[in,out]  workers     自己対局スレッド
+/// @param[in]      store       対局の保存先（-g・--recordで指定した棋譜ファイル、なければNULL）
+/// @param[in]      metrics     計測ファイル（NULLのとき書き出さない）
+/// @param[in,out]  checkpoint  途中経過（終えた対局の次から対局する）
+/// @param[in]      setting     学習設定
+/// @note   学習するかは保存先によらず、checkpoint->learning（-gを指定していないか）で決まる
+///
+static void run_learning(Evaluator *evaluator, Worker *workers, FILE *store, FILE *metrics, Checkpoint *checkpoint, const LearnSetting *setting)
+{
+    const int threads   = setting->threads;
+    const int iteration = setting->iteration;
+    const bool csv = metrics && is_csv(setting->metrics_file);
+    const bool learning = checkpoint->learning;
+    const bool text = store && Record_is_text(setting->game_file ? setting->game_file : setting->record_file);
+    Metrics     stat;
+    SampleTable samples;
+    bool        ready = init_samples(&samples, UPDATE_INTERVAL * MAX_RECORD_MOVES);
+    Board       *board = Board_create();
+    int         colors[MAX_RECORD_MOVES];
 
-        int color = BLACK;
-        int move;
-        int turn = 0;
-        int value;
+    if (!ready || !board) {
+        printf("failed to allocate samples\n");
+        free_samples(&samples);
+        if (board) {
+            Board_delete(board);
+        }
+        return;
+    }
 
-        // 初期8手はランダムに着手する
-        for (int j = 0; j < 8; j++) {
-            if (Board_can_play(board, color)) {
-                move_random(board, color);
-                history[turn] = color;
-                turn++;
+    printf(learning ? "Start learning\n" : "Start generating\n");
+
+    begin_metrics(&stat, workers, threads);
+
+    for (int i = checkpoint->games; i < iteration; ) {
+        // 評価値を読むだけの対局はスレッド並列に行い、更新は全スレッド終了後に行う
+        // 更新までの対局数はスレッド数によらず一定とし、スレッドへ順に割り当てる
+        int games = UPDATE_INTERVAL;
+        if (games > (iteration - i)) {
+            games = iteration - i;
+        }
+        for (int j = 0; j < threads; j++) {
+            workers[j].first = i;
+            workers[j].games = games;
+        }
+
+        for (int j = 0; j < threads; j++) {
+            workers[j].running = (pthread_create(&workers[j].thread, NULL, run_worker, &workers[j]) == 0);
+            if (!workers[j].running) {
+                // スレッド生成できないときはこのスレッドで対局する
+                run_worker(&workers[j]);
             }
-            color = Board_opponent(color);
         }
+        for (int j = 0; j < threads; j++) {
+            if (workers[j].running) {
+                pthread_join(workers[j].thread, NULL);
+            }
+            stat.positions += workers[j].positions;
+            stat.search    += workers[j].search;
+            workers[j].positions = 0;
+            workers[j].search    = 0;
+        }
+        stat.games += games;
 
-        while (true) {
-            if (Board_can_play(board, color)) {
-                // ランダム着手: 空きマス12以上のとき、1%の確率
-                if ((Board_count_disks(board, EMPTY) > 12) && (get_rand(100) < 1)) {
-                    move_random(board, color);
+        if (store) {
+            // 棋譜は対局番号順に保存する
+            for (int j = 0; j < games; j++) {
+                const Record *record = &workers[j % threads].records[j / threads];
+                if (text) {
+                    Record_write_text(store, record);
                 } else {
-                    move = Com_get_nextmove(com, board, color, &value);
-                    Board_flip(board, color, move);
+                    Record_write(store, record);
                 }
-
-                history[turn] = color;
-                turn++;
-            } else if (!Board_can_play(board, Board_opponent(color))){
-                break;
             }
-            color = Board_opponent(color);
         }
+        if (learning) {
+            double start = now();
 
-        // 評価値: 終局時の石数差
-        int result = (Board_count_disks(board, BLACK) - Board_count_disks(board, WHITE)) * DISK_VALUE;
+            // 学習局面は対局番号順に集計し、スレッド数によらず同じ順に評価器へ登録する
+            for (int j = 0; j < games; j++) {
+                const Record *record = &workers[j % threads].records[j / threads];
+                Record_replay(record, board, colors);
+                add_positions(&samples, evaluator, board, colors, record->num);
+            }
+            flush_samples(&samples, evaluator);
+            stat.error  += samples.error;
+            stat.weight += samples.weight;
+            samples.error  = 0;
+            samples.weight = 0;
 
-        // 終盤探索する最後8手は評価に含めないため除く
-        for (int j = Board_count_disks(board, EMPTY); j < 8; j++) {
-            turn--;
-            Board_unflip(board);
+            // 評価パラメータの更新
+            stat.changed += Evaluator_update(evaluator);
+            stat.update += now() - start;
         }
 
-        for (int j = Board_count_disks(board, EMPTY); j < (BOARD_SIZE * BOARD_SIZE - 12); j++) {
-            turn--;
-            Board_unflip(board);
-            if (history[turn] == BLACK) {
-                // 石数差を評価値として局面を登録する
-                Evaluator_add(evaluator, board, result);
+        // 100局単位で進捗を表示し、評価パラメータを保存する
+        if ((i / SAVE_INTERVAL) != ((i + games) / SAVE_INTERVAL)) {
+            if (learning) {
+                printf("Learning ... %d / %d (%d weights updated)\n", (i + games), iteration, stat.changed);
+                Evaluator_save(evaluator, setting->eval_file);
             } else {
-                // パラメータ調整は黒番局面で揃える: 色反転し負の評価値で登録する
-                Board_reverse(board);
-                Evaluator_add(evaluator, board, -result);
-                Board_reverse(board);
+                printf("Generating ... %d / %d\n", (i + games), iteration);
             }
+            checkpoint->games = i + games;
+            if (!save_checkpoint(setting->checkpoint_file, checkpoint, evaluator, store)) {
+                printf("failed to save %s\n", setting->checkpoint_file);
+            }
+            if (metrics) {
+                write_metrics(metrics, csv, &stat, workers, threads, (i + games));
+            }
+            begin_metrics(&stat, workers, threads);
         }
 
-        // 評価パラメータの更新: 10局単位
-        if ((i + 1) % 10 == 0) {
-            Evaluator_update(evaluator);
+        i += games;
+    }
+
+    // 端数の対局の集計
+    if (metrics && (stat.games > 0)) {
+        write_metrics(metrics, csv, &stat, workers, threads, iteration);
+    }
+
+    if (learning) {
+        Evaluator_save(evaluator, setting->eval_file);
+    }
+    if (checkpoint->games < iteration) {
+        checkpoint->games = iteration;
+        if (!save_checkpoint(setting->checkpoint_file, checkpoint, evaluator, store)) {
+            printf("failed to save %s\n", setting->checkpoint_file);
         }
+    }
+    printf("Finished\n");
 
-        // 評価パラメータの保存: 100局単位
-        if ((i + 1) % 100 == 0) {
-            printf("Learning ... %d / %d\n", (i + 1), iteration);
-            Evaluator_save(evaluator, file);
+    free_samples(&samples);
+    Board_delete(board);
+}
+
+bool train(Evaluator *evaluator, const char *game_file, const int batch, const char *file)
+{
+    RecordReader *reader = RecordReader_open(game_file);
+    if (!reader) {
+        printf("failed to open %s\n", game_file);
+        return false;
+    }
+
+    // まとめる学習局面数は更新局数ぶん（上限MAX_SAMPLES）
+    Board *board = Board_create();
+    SampleTable samples;
+    bool ready = init_samples(&samples, ((long)batch * MAX_RECORD_MOVES < MAX_SAMPLES) ? (batch * MAX_RECORD_MOVES) : MAX_SAMPLES);
+    if (!board || !ready) {
+        if (board) {
+            Board_delete(board);
         }
+        free_samples(&samples);
+        RecordReader_close(reader);
+        return false;
     }
 
-    Evaluator_save(evaluator, file);
-    printf("Finished\n");
+    Record record;
+    int    colors[MAX_RECORD_MOVES];
+    long   games   = 0;
+    long   invalid = 0;
+
+    printf("Start training\n");
+
+    // 棋譜を1局ずつ読み込み、局面を再構成して登録する
+    while (RecordReader_next(reader, &record, board, colors)) {
+        if ((Board_can_play(board, BLACK) || Board_can_play(board, WHITE)) ||
+            ((Board_count_disks(board, BLACK) - Board_count_disks(board, WHITE)) != record.result)) {
+            // 終局していない・結果が一致しない棋譜は除く（無効手を含む棋譜は読み込み器が除く）
+            invalid++;
+            continue;
+        }
+
+        add_positions(&samples, evaluator, board, colors, record.num);
+        games++;
+
+        // 評価パラメータの更新: 指定局数単位
+        if ((games % batch) == 0) {
+            flush_samples(&samples, evaluator);
+            printf("Training ... %ld (%d weights updated)\n", games, Evaluator_update(evaluator));
+        }
+    }
+
+    if ((games % batch) != 0) {
+        flush_samples(&samples, evaluator);
+        Evaluator_update(evaluator);
+    }
+
+    printf("Finished: %ld games, %ld invalid\n", games, invalid + RecordReader_count_invalid(reader));
+
+    // 学習できる棋譜がないときは評価値ファイルを書き換えない
+    bool result = (games > 0);
+    if (!result) {
+        printf("no valid games in %s\n", game_file);
+    } else if (!Evaluator_save(evaluator, file)) {
+        printf("failed to save %s\n", file);
+        result = false;
+    }
+
+    free_samples(&samples);
+    Board_delete(board);
+    RecordReader_close(reader);
+
+    return result;
+}
+
+///
+/// @fn     run_gradient
+/// @brief  担当する局面の二乗誤差と勾配を求める
+/// @param[in,out]  arg     データセット学習スレッド (Trainer *)
+/// @return NULL
+///
+static void *run_gradient(void *arg)
+{
+    Trainer *trainer = arg;
+    int features[NUM_FEATURE];
+
+    trainer->loss   = 0;
+    trainer->weight = 0;
+
+    for (size_t i = trainer->begin; i < trainer->end; i++) {
+        const DatasetEntry *entry = Dataset_entry(trainer->dataset, i);
+
+        Evaluator_features(trainer->evaluator, entry->index, entry->empties, features);
+
+        double value = 0;
+        for (int j = 0; j < NUM_FEATURE; j++) {
+            value += trainer->weights[features[j]];
+        }
+
+        // 評価値の誤差: 石数差 - 評価値（同じ局面の出現回数で重み付けする）
+        double error = (double)entry->result * DISK_VALUE - value;
+        trainer->loss   += error * error * entry->weight;
+        trainer->weight += entry->weight;
+
+        for (int j = 0; j < NUM_FEATURE; j++) {
+            trainer->grad[features[j]]  += error * entry->weight;
+            trainer->count[features[j]] += entry->weight;
+        }
+    }
+
+    return NULL;
+}
+
+///
+/// @fn     run_reduce
+/// @brief  担当する評価値について全スレッドの勾配を集約し、評価値を更新する
+/// @param[in,out]  arg     データセット学習スレッド (Trainer *)
+/// @return NULL
+/// @note   評価値ごとに出現回数で正規化した勾配で更新する
+///
+static void *run_reduce(void *arg)
+{
+    Trainer *trainer = arg;
+
+    for (int i = trainer->first; i < trainer->last; i++) {
+        double grad  = 0;
+        int    count = 0;
+
+        for (int j = 0; j < trainer->threads; j++) {
+            grad  += trainer->all[j].grad[i];
+            count += trainer->all[j].count[i];
+            trainer->all[j].grad[i]  = 0;
+            trainer->all[j].count[i] = 0;
+        }
+
+        if (count > 0) {
+            trainer->weights[i] += trainer->rate * grad / count;
+        }
+    }
+
+    return NULL;
+}
+
+///
+/// @fn     run_trainers
+/// @brief  全データセット学習スレッドで処理を実行し、終了を待つ
+/// @param[in,out]  trainers    データセット学習スレッド
+/// @param[in]      threads     スレッド数
+/// @param[in]      func        実行する処理
+///
+static void run_trainers(Trainer *trainers, int threads, void *(*func)(void *))
+{
+    for (int i = 0; i < threads; i++) {
+        trainers[i].running = (pthread_create(&trainers[i].thread, NULL, func, &trainers[i]) == 0);
+        if (!trainers[i].running) {
+            // スレッド生成できないときはこのスレッドで処理する
+            func(&trainers[i]);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        if (trainers[i].running) {
+            pthread_join(trainers[i].thread, NULL);
+        }
+    }
+}
+
+bool fit(Evaluator *evaluator, const char *dataset_file, const FitSetting *setting)
+{
+    Dataset *dataset = Dataset_open(dataset_file);
+    if (!dataset) {
+        printf("failed to open %s\n", dataset_file);
+        return false;
+    }
+
+    const int threads     = setting->threads;
+    const int num_weights = Evaluator_num_weights(evaluator);
+    const size_t num      = Dataset_size(dataset);
+    const size_t batch    = ((setting->batch > 0) && ((size_t)setting->batch < num)) ? (size_t)setting->batch : num;
+    const size_t num_batch = (num > 0) ? ((num + batch - 1) / batch) : 0;
+
+    double  *weights  = malloc(num_weights * sizeof(double));
+    size_t  *order    = malloc((num_batch + 1) * sizeof(size_t));
+    Trainer *trainers = calloc(threads, sizeof(Trainer));
+    bool    ready     = (weights && order && trainers);
+
+    // スレッドごとに勾配を持ち、評価値は範囲を分けて集約する
+    for (int i = 0; ready && (i < threads); i++) {
+        trainers[i].evaluator = evaluator;
+        trainers[i].dataset   = dataset;
+        trainers[i].weights   = weights;
+        trainers[i].grad      = calloc(num_weights, sizeof(double));
+        trainers[i].count     = calloc(num_weights, sizeof(int));
+        trainers[i].first     = (int)((long long)num_weights * i / threads);
+        trainers[i].last      = (int)((long long)num_weights * (i + 1) / threads);
+        trainers[i].rate      = setting->rate;
+        trainers[i].all       = trainers;
+        trainers[i].threads   = threads;
+        ready = (trainers[i].grad && trainers[i].count);
+    }
+
+    if (ready) {
+        Random random;
+        Random_init(&random, setting->seed);
+
+        Evaluator_get_weights(evaluator, weights);
+        for (size_t i = 0; i < num_batch; i++) {
+            order[i] = i;
+        }
+
+        printf("Start fitting: %zu positions, %zu per update\n", num, batch);
+
+        for (int epoch = 0; epoch < setting->epochs; epoch++) {
+            double loss   = 0;
+            double weight = 0;
+
+            // 更新単位の局面を走査する順序を入れ替える
+            for (size_t i = num_batch; i > 1; i--) {
+                size_t j = (size_t)Random_int(&random, (int)i);
+                size_t tmp = order[i - 1];
+                order[i - 1] = order[j];
+                order[j]     = tmp;
+            }
+
+            for (size_t b = 0; b < num_batch; b++) {
+                size_t begin = order[b] * batch;
+                size_t end   = (begin + batch < num) ? (begin + batch) : num;
+
+                for (int i = 0; i < threads; i++) {
+                    trainers[i].begin = begin + (end - begin) * i / threads;
+                    trainers[i].end   = begin + (end - begin) * (i + 1) / threads;
+                }
+
+                run_trainers(trainers, threads, run_gradient);
+                for (int i = 0; i < threads; i++) {
+                    loss   += trainers[i].loss;
+                    weight += trainers[i].weight;
+                }
+                run_trainers(trainers, threads, run_reduce);
+            }
+
+            // 損失: 石数差単位の平均二乗誤差（更新前の評価値による）
+            printf("epoch %d / %d: loss %.4f\n", (epoch + 1), setting->epochs,
+                   (weight > 0) ? (loss / weight / ((double)DISK_VALUE * DISK_VALUE)) : 0.0);
+        }
+
+        Evaluator_set_weights(evaluator, weights);
+        ready = Evaluator_save(evaluator, setting->eval_file);
+        printf("Finished\n");
+    } else {
+        printf("failed to allocate trainers\n");
+    }
+
+    for (int i = 0; trainers && (i < threads); i++) {
+        free(trainers[i].count);
+        free(trainers[i].grad);
+    }
+    free(trainers);
+    free(order);
+    free(weights);
+
+    Dataset_close(dataset);
+
+    return ready;
 }
@@ -7,12 +7,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <time.h>
 #include <getopt.h>
 
 #include "board.h"
 #include "com.h"
 #include "evaluator.h"
 #include "learn.h"
+#include "dataset.h"
+#include "record.h"
+#include "perft.h"
+#include "bench.h"
+#include "analyze.h"
+#include "benchresult.h"
+#include "trace.h"
 
 ///
 /// @struct Setting
@@ -21,6 +29,43 @@
 typedef struct {
     int player_turn;    ///< プレイヤー手番
     int learn_iter;     ///< 学習回数
+    int cache_size;     ///< 評価値キャッシュのエントリ数
+    int threads;        ///< 学習スレッド数
+    const char *game_file;  ///< 自己対局の保存先
+    const char *train_file; ///< 学習に使う棋譜ファイル
+    int batch;          ///< 評価値を更新する局数・局面数
+    const char *dataset_file;   ///< 作成するデータセットファイル
+    const char *fit_file;       ///< 学習に使うデータセットファイル
+    int epochs;         ///< データセット学習の走査回数
+    double rate;        ///< データセット学習の学習率
+    uint64_t seed;      ///< 乱数シード
+    int endcache_size;  ///< 終盤キャッシュのエントリ数
+    int endcache_empties;   ///< 終盤キャッシュを使う最大の空きマス数
+    const char *endcache_file;  ///< 終盤キャッシュの保存先
+    const char *metrics_file;   ///< 学習の計測ファイル
+    const char *checkpoint_file;    ///< 自己対局の途中経過ファイル
+    bool resume;        ///< 途中経過から再開するか
+    int node_budget;    ///< 自己対局の1手あたりの探索ノード数の上限
+    double time_budget; ///< 自己対局の1手あたりの探索時間[s]の上限
+    int perft_depth;    ///< perftの手数
+    bool perft_bulk;    ///< perftの最後の1手は有効手数を数えるか
+    const char *position;   ///< perftの開始局面（NULLのとき初期局面）
+    const char *bench_file; ///< 終盤ベンチマークの局面集
+    const char *json_file;  ///< ベンチマーク結果のJSON出力先
+    const char *result_file;    ///< 比較用のベンチマーク結果の出力先
+    const char *compare_base;   ///< 比較の基準とするベンチマーク結果
+    const char *compare_file;   ///< 比較するベンチマーク結果
+    double threshold;   ///< 悪化とみなす割合[%]
+    const char *analyze_file;   ///< 解析する局面集
+    int analyze_depth;  ///< 解析の中盤探索の深さ
+    int analyze_exact;  ///< 解析で完全読みする空きマス数
+    int multipv;        ///< 解析で求める手数
+    const char *trace_file; ///< 探索の区間計測の出力先
+    int trace_sample;   ///< 区間計測の標本化の間隔
+    const char *record_file;    ///< 対局を追記する棋譜ファイル
+    const char *convert_file;   ///< 変換する棋譜ファイル
+    const char *convert_out;    ///< 変換先のファイル
+    bool positions;     ///< 棋譜を局面に変換するか
 } Setting;
 
 const char option_str[] = "options\n \
@@ -29,6 +74,76 @@ const char option_str[] = "options\n \
     -c  COM vs COM\n \
     -l iterations\n\
         self-playing learning by specified iterations\n \
+    -j threads\n\
+        number of self-playing threads for learning\n \
+    -g file\n\
+        save self-play games to file instead of learning (with -l)\n \
+    -t file\n\
+        learn from games saved by -g or --record (binary or text)\n \
+    -u size\n\
+        games (-t, 1000 by default) or positions (-f, all by default) per update\n \
+    -d file\n\
+        build a position dataset from games given by -t instead of learning\n \
+    -f file\n\
+        learn from a position dataset by gradient descent\n \
+    -n epochs\n\
+        passes over the dataset (10 by default)\n \
+    -r rate\n\
+        learning rate for -f (0.02 by default)\n \
+    --seed seed\n\
+        random seed for learning (0 by default, same seed gives same games)\n \
+    --metrics file\n\
+        append learning throughput and error every 100 games (-l, CSV if *.csv, JSON lines otherwise)\n \
+    --checkpoint file\n\
+        save self-play progress every 100 games to file (-l, learn.ckpt by default)\n \
+    --resume\n\
+        resume self-play from the checkpoint (-l, iterations is the total number of games)\n \
+    --nodes nodes\n\
+        search node budget per self-play move or analyzed position (-l, -a, 0 for unlimited by default)\n \
+    --movetime ms\n\
+        search time budget per self-play move or analyzed position in milliseconds (-l, -a, 0 for unlimited by default)\n \
+    --endcache-size entries\n\
+        endgame result cache entries (power of 2, 0 to disable)\n \
+    --endcache-empties empties\n\
+        cache endgame results at or below this number of empties (12 by default)\n \
+    --endcache-file file\n\
+        load the endgame result cache from file and save it on exit\n \
+    -e entries\n\
+        evaluation cache entries (power of 2, 0 to disable)\n \
+    -p depth\n\
+        count leaf nodes up to depth (perft) and compare with known counts\n \
+    --bulk\n\
+        count legal moves at the last ply instead of playing them (-p)\n \
+    --position board\n\
+        start position for -p (64 chars of X/O/- from A1 to H8, then side to move X/O)\n \
+    --bench file\n\
+        solve endgame positions in file (FFO/Edax .obf format) and check scores and best moves\n \
+    --json file\n\
+        write benchmark results to file as JSON (--bench)\n \
+    --result file\n\
+        write metrics with build and machine info to file for --compare (--bench, -p)\n \
+    --compare base current\n\
+        compare metrics in result files and fail on regressions\n \
+    --threshold percent\n\
+        minimum regression reported by --compare (5 by default)\n \
+    -a file\n\
+        analyze positions in file (one per line, format of --position) with -j threads\n \
+    --depth depth\n\
+        midgame search depth for -a (6 by default)\n \
+    --exact empties\n\
+        solve positions for -a exactly at or below this number of empties (14 by default)\n \
+    --multipv k\n\
+        report the best k moves for -a (1 by default, --nodes/--movetime limit -a only when 1)\n \
+    --trace file\n\
+        write search phase timeline to file as Chrome trace JSON (build with make TRACE=yes)\n \
+    --trace-sample interval\n\
+        record 1 of interval evaluator and move ordering calls per thread (--trace, 1000 by default)\n \
+    --record file\n\
+        append finished games to file while playing or learning (-l, text if *.txt, binary otherwise)\n \
+    --convert in out\n\
+        convert game records (text if *.txt, binary otherwise) and skip illegal games\n \
+    --positions\n\
+        write every position of the games for -a instead of records (--convert)\n \
     -h  show this help\n";
 
 ///
@@ -37,12 +152,89 @@ const char option_str[] = "options\n \
 ///
 #define EVAL_FILE "eval.dat"
 
+///
+/// @def    EVAL_CACHE_SIZE
+/// @brief  評価値キャッシュのエントリ数の既定値
+///
+#define EVAL_CACHE_SIZE (1 << 16)
+
+///
+/// @def    TRAIN_BATCH
+/// @brief  棋譜学習で評価値を更新する局数の既定値
+///
+#define TRAIN_BATCH 1000
+
+///
+/// @def    FIT_EPOCHS
+/// @brief  データセット学習の走査回数の既定値
+///
+#define FIT_EPOCHS 10
+
+///
+/// @def    FIT_RATE
+/// @brief  データセット学習の学習率の既定値
+///
+#define FIT_RATE 0.02
+
+///
+/// @def    LEARN_SEED
+/// @brief  学習の乱数シードの既定値
+///
+#define LEARN_SEED 0
+
+///
+/// @def    CHECKPOINT_FILE
+/// @brief  自己対局の途中経過ファイル名の既定値
+///
+#define CHECKPOINT_FILE "learn.ckpt"
+
+///
+/// @def    ENDCACHE_SIZE
+/// @brief  終盤キャッシュのエントリ数の既定値
+///
+#define ENDCACHE_SIZE (1 << 20)
+
+///
+/// @def    ENDCACHE_EMPTIES
+/// @brief  終盤キャッシュを使う最大の空きマス数の既定値
+///
+#define ENDCACHE_EMPTIES 12
+
+///
+/// @def    COMPARE_THRESHOLD
+/// @brief  ベンチマーク結果の比較で悪化とみなす割合[%]の既定値
+///
+#define COMPARE_THRESHOLD 5.0
+
+///
+/// @def    ANALYZE_DEPTH
+/// @brief  解析の中盤探索の深さの既定値
+///
+#define ANALYZE_DEPTH 6
+
+///
+/// @def    ANALYZE_EXACT
+/// @brief  解析で完全読みする空きマス数の既定値
+///
+#define ANALYZE_EXACT 14
+
+///
+/// @def    TRACE_SAMPLE
+/// @brief  区間計測で評価・着手の並び替えを記録する間隔の既定値
+///
+#define TRACE_SAMPLE 1000
+
 static bool parse_options(int argc, char* argv[], Setting *setting);
 
 static char *get_stream(char *buffer, const int size, FILE *stream);
 
 static void print_board(const Board *board, const int color);
 static void play(Board *board, Com *com, Setting *setting);
+static bool run_perft(Board *board, const Setting *setting, BenchResult *bench_result);
+static bool run_compare(const Setting *setting);
+static bool append_record(const char *file, const Record *record);
+static bool write_positions(FILE *fp, Board *board, const Record *record, const int *colors);
+static bool run_convert(const Setting *setting);
 
 ///
 /// @fn     parse_options
@@ -57,9 +249,75 @@ static bool parse_options(int argc, char* argv[], Setting *setting)
 {
     setting->player_turn = BLACK;
     setting->learn_iter  = 0;
+    setting->cache_size  = EVAL_CACHE_SIZE;
+    setting->threads     = 1;
+    setting->game_file   = NULL;
+    setting->train_file  = NULL;
+    setting->batch       = 0;
+    setting->dataset_file = NULL;
+    setting->fit_file    = NULL;
+    setting->epochs      = FIT_EPOCHS;
+    setting->rate        = FIT_RATE;
+    setting->seed        = LEARN_SEED;
+    setting->endcache_size    = ENDCACHE_SIZE;
+    setting->endcache_empties = ENDCACHE_EMPTIES;
+    setting->endcache_file    = NULL;
+    setting->metrics_file     = NULL;
+    setting->checkpoint_file  = CHECKPOINT_FILE;
+    setting->resume           = false;
+    setting->node_budget      = 0;
+    setting->time_budget      = 0;
+    setting->perft_depth      = 0;
+    setting->perft_bulk       = false;
+    setting->position         = NULL;
+    setting->bench_file       = NULL;
+    setting->json_file        = NULL;
+    setting->result_file      = NULL;
+    setting->compare_base     = NULL;
+    setting->compare_file     = NULL;
+    setting->threshold        = COMPARE_THRESHOLD;
+    setting->analyze_file     = NULL;
+    setting->analyze_depth    = ANALYZE_DEPTH;
+    setting->analyze_exact    = ANALYZE_EXACT;
+    setting->multipv          = 1;
+    setting->trace_file       = NULL;
+    setting->trace_sample     = TRACE_SAMPLE;
+    setting->record_file      = NULL;
+    setting->convert_file     = NULL;
+    setting->convert_out      = NULL;
+    setting->positions        = false;
 
     int opt;
-    while ((opt = getopt(argc, argv, "bwcl:h")) != -1) {
+    // 長いオプションは短いオプションのない値を返す
+    static const struct option long_options[] = {
+        { "seed",             required_argument, NULL, 'S' },
+        { "endcache-size",    required_argument, NULL, 'C' },
+        { "endcache-empties", required_argument, NULL, 'E' },
+        { "endcache-file",    required_argument, NULL, 'F' },
+        { "metrics",          required_argument, NULL, 'M' },
+        { "checkpoint",       required_argument, NULL, 'K' },
+        { "resume",           no_argument,       NULL, 'R' },
+        { "nodes",            required_argument, NULL, 'N' },
+        { "movetime",         required_argument, NULL, 'T' },
+        { "bulk",             no_argument,       NULL, 'B' },
+        { "position",         required_argument, NULL, 'P' },
+        { "bench",            required_argument, NULL, 'H' },
+        { "json",             required_argument, NULL, 'J' },
+        { "result",           required_argument, NULL, 'O' },
+        { "compare",          required_argument, NULL, 'D' },
+        { "threshold",        required_argument, NULL, 'Y' },
+        { "depth",            required_argument, NULL, 'G' },
+        { "exact",            required_argument, NULL, 'X' },
+        { "multipv",          required_argument, NULL, 'V' },
+        { "trace",            required_argument, NULL, 'Z' },
+        { "trace-sample",     required_argument, NULL, 'Q' },
+        { "record",           required_argument, NULL, 'A' },
+        { "convert",          required_argument, NULL, 'I' },
+        { "positions",        no_argument,       NULL, 'L' },
+        { NULL,   0,                 NULL, 0   },
+    };
+
+    while ((opt = getopt_long(argc, argv, "bwcl:j:e:g:t:u:d:f:n:r:p:a:h", long_options, NULL)) != -1) {
         switch (opt) {
             case 'b':
                 // -b: プレイヤー手番黒（先攻）
@@ -77,6 +335,152 @@ static bool parse_options(int argc, char* argv[], Setting *setting)
                 // -l iteration: 指定回数の学習
                 setting->learn_iter = atoi(optarg);
                 break;
+            case 'j':
+                // -j threads: 学習スレッド数
+                setting->threads = atoi(optarg);
+                if (setting->threads < 1) {
+                    setting->threads = 1;
+                }
+                break;
+            case 'e':
+                // -e entries: 評価値キャッシュのエントリ数
+                setting->cache_size = atoi(optarg);
+                break;
+            case 'g':
+                // -g file: 自己対局の保存先
+                setting->game_file = optarg;
+                break;
+            case 't':
+                // -t file: 棋譜から学習
+                setting->train_file = optarg;
+                break;
+            case 'u':
+                // -u size: 評価値を更新する局数・局面数
+                setting->batch = atoi(optarg);
+                if (setting->batch < 0) {
+                    setting->batch = 0;
+                }
+                break;
+            case 'd':
+                // -d file: データセットの作成
+                setting->dataset_file = optarg;
+                break;
+            case 'f':
+                // -f file: データセットから学習
+                setting->fit_file = optarg;
+                break;
+            case 'n':
+                // -n epochs: データセット学習の走査回数
+                setting->epochs = atoi(optarg);
+                break;
+            case 'r':
+                // -r rate: データセット学習の学習率
+                setting->rate = atof(optarg);
+                break;
+            case 'S':
+                // --seed seed: 乱数シード
+                setting->seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'C':
+                // --endcache-size entries: 終盤キャッシュのエントリ数
+                setting->endcache_size = atoi(optarg);
+                break;
+            case 'E':
+                // --endcache-empties empties: 終盤キャッシュを使う最大の空きマス数
+                setting->endcache_empties = atoi(optarg);
+                break;
+            case 'F':
+                // --endcache-file file: 終盤キャッシュの保存先
+                setting->endcache_file = optarg;
+                break;
+            case 'M':
+                // --metrics file: 学習の計測ファイル
+                setting->metrics_file = optarg;
+                break;
+            case 'K':
+                // --checkpoint file: 自己対局の途中経過ファイル
+                setting->checkpoint_file = optarg;
+                break;
+            case 'R':
+                // --resume: 途中経過から再開
+                setting->resume = true;
+                break;
+            case 'p':
+                // -p depth: perft
+                setting->perft_depth = atoi(optarg);
+                break;
+            case 'B':
+                // --bulk: perftの最後の1手は有効手数を数える
+                setting->perft_bulk = true;
+                break;
+            case 'P':
+                // --position board: perftの開始局面
+                setting->position = optarg;
+                break;
+            case 'H':
+                // --bench file: 終盤ベンチマーク
+                setting->bench_file = optarg;
+                break;
+            case 'J':
+                // --json file: ベンチマーク結果のJSON出力先
+                setting->json_file = optarg;
+                break;
+            case 'O':
+                // --result file: 比較用のベンチマーク結果の出力先
+                setting->result_file = optarg;
+                break;
+            case 'D':
+                // --compare base current: ベンチマーク結果の比較
+                setting->compare_base = optarg;
+                break;
+            case 'Y':
+                // --threshold percent: 悪化とみなす割合
+                setting->threshold = atof(optarg);
+                break;
+            case 'a':
+                // -a file: 局面集の解析
+                setting->analyze_file = optarg;
+                break;
+            case 'G':
+                // --depth depth: 解析の中盤探索の深さ
+                setting->analyze_depth = atoi(optarg);
+                break;
+            case 'X':
+                // --exact empties: 解析で完全読みする空きマス数
+                setting->analyze_exact = atoi(optarg);
+                break;
+            case 'V':
+                // --multipv k: 解析で求める手数
+                setting->multipv = atoi(optarg);
+                break;
+            case 'Z':
+                // --trace file: 探索の区間計測の出力先
+                setting->trace_file = optarg;
+                break;
+            case 'Q':
+                // --trace-sample interval: 区間計測の標本化の間隔
+                setting->trace_sample = atoi(optarg);
+                break;
+            case 'A':
+                // --record file: 対局を追記する棋譜ファイル
+                setting->record_file = optarg;
+                break;
+            case 'I':
+                // --convert in out: 棋譜の変換
+                setting->convert_file = optarg;
+                break;
+            case 'L':
+                // --positions: 棋譜を局面に変換
+                setting->positions = true;
+                break;
+            case 'N':
+                // --nodes nodes: 自己対局の1手あたりの探索ノード数の上限
+                setting->node_budget = atoi(optarg);
+                break;
+            case 'T':
+                // --movetime ms: 自己対局の1手あたりの探索時間の上限
+                setting->time_budget = atof(optarg) / 1000;
+                break;
             case 'h':
                 // -h: ヘルプ表示
                 printf(option_str);
@@ -89,6 +493,24 @@ static bool parse_options(int argc, char* argv[], Setting *setting)
         }
     }
 
+    // 比較するベンチマーク結果はオプション以外の引数で指定する
+    if (setting->compare_base) {
+        if (optind >= argc) {
+            printf("--compare requires base and current result files\n");
+            return false;
+        }
+        setting->compare_file = argv[optind];
+    }
+
+    // 変換先の棋譜もオプション以外の引数で指定する
+    if (setting->convert_file) {
+        if (optind >= argc) {
+            printf("--convert requires input and output files\n");
+            return false;
+        }
+        setting->convert_out = argv[optind];
+    }
+
     return true;
 }
 
@@ -166,15 +588,23 @@ static void play(Board *board, Com *com, Setting *setting)
     int  val;
     // 入力バッファ
     char buffer[32];
+    Record record;
+
+    Record_init(&record);
 
     Com_set_level(com, 6, 10, 6);
 
+    // COM戦では反復ごとの探索結果を表示する
+    if (setting->player_turn == EMPTY) {
+        Com_set_report(com, stdout);
+    }
+
     while (true) {
         print_board(board, turn);
 
         if (Board_can_play(board, turn)) {
-            printf(">> ");
             if (turn == setting->player_turn) {
+                printf(">> ");
                 while (true) {
                     while (!get_stream(buffer, sizeof(buffer), stdin)) {
                         printf(">> ");
@@ -187,10 +617,11 @@ static void play(Board *board, Com *com, Setting *setting)
                 }
             } else {
                 move = Com_get_nextmove(com, board, turn, &val);
-                printf("%c%c\n", POS2COL(move), POS2ROW(move));
+                printf(">> %c%c\n", POS2COL(move), POS2ROW(move));
             }
 
             Board_flip(board, turn, move);
+            Record_add(&record, move);
         } else if (Board_can_play(board, Board_opponent(turn))) {
             printf("pass\n");
         } else {
@@ -209,6 +640,11 @@ static void play(Board *board, Com *com, Setting *setting)
     } else {
         printf("* draw *\n");
     }
+
+    record.result = diff;
+    if (setting->record_file && !append_record(setting->record_file, &record)) {
+        printf("failed to write %s\n", setting->record_file);
+    }
 }
 
 int main(int argc, char *argv[])
@@ -218,24 +654,326 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    // ベンチマーク結果の比較は盤面・評価値を使わない
+    if (setting.compare_base) {
+        exit(run_compare(&setting) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    // 棋譜の変換も盤面・評価値を使わない
+    if (setting.convert_file) {
+        exit(run_convert(&setting) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
     Board *board = Board_create();
 
     Evaluator *evaluator = Evaluator_create();
     Evaluator_load(evaluator, EVAL_FILE);
 
     Com *com = Com_create(evaluator);
+    if (!Com_set_cache(com, setting.cache_size)) {
+        printf("failed to allocate evaluation cache\n");
+    }
+
+    // 終盤キャッシュは評価値によらないため、対局・学習をまたいで保存できる
+    EndCache *endcache = EndCache_create(setting.endcache_size);
+    if (endcache && setting.endcache_file) {
+        EndCache_load(endcache, setting.endcache_file);
+    }
+    Com_set_endcache(com, endcache, setting.endcache_empties);
+
+    int status = EXIT_SUCCESS;
+
+    bool tracing = setting.trace_file && Trace_start(setting.trace_sample);
+    if (setting.trace_file && !tracing) {
+        printf("tracing is not built in (make TRACE=yes)\n");
+    }
 
-    if (setting.learn_iter > 0) {
-        learn(board, evaluator, com, setting.learn_iter, EVAL_FILE);
+    BenchResult *bench_result = NULL;
+    if (setting.result_file && ((setting.perft_depth > 0) || setting.bench_file)) {
+        bench_result = BenchResult_create();
+    }
+
+    if (setting.perft_depth > 0) {
+        if (!run_perft(board, &setting, bench_result)) {
+            status = EXIT_FAILURE;
+        }
+    } else if (setting.bench_file) {
+        if (!bench_endgame(com, setting.bench_file, setting.json_file, bench_result)) {
+            status = EXIT_FAILURE;
+        }
+    } else if (setting.analyze_file) {
+        AnalyzeSetting analyze_setting = {
+            .threads     = setting.threads,
+            .mid_depth   = setting.analyze_depth,
+            .exact_depth = setting.analyze_exact,
+            .multipv     = setting.multipv,
+            .node_budget = setting.node_budget,
+            .time_budget = setting.time_budget,
+        };
+        if (!analyze(com, setting.analyze_file, &analyze_setting)) {
+            status = EXIT_FAILURE;
+        }
+    } else if (setting.fit_file) {
+        FitSetting fit_setting = {
+            .epochs    = setting.epochs,
+            .batch     = setting.batch,
+            .rate      = setting.rate,
+            .threads   = setting.threads,
+            .eval_file = EVAL_FILE,
+            .seed      = setting.seed,
+        };
+        if (!fit(evaluator, setting.fit_file, &fit_setting)) {
+            status = EXIT_FAILURE;
+        }
+    } else if (setting.train_file && setting.dataset_file) {
+        size_t total, num;
+        if (Dataset_build(setting.train_file, setting.dataset_file, &total, &num)) {
+            printf("%zu positions (%zu unique) written to %s\n", total, num, setting.dataset_file);
+        } else {
+            printf("failed to build %s\n", setting.dataset_file);
+            status = EXIT_FAILURE;
+        }
+    } else if (setting.train_file) {
+        if (!train(evaluator, setting.train_file, (setting.batch > 0) ? setting.batch : TRAIN_BATCH, EVAL_FILE)) {
+            status = EXIT_FAILURE;
+        }
+    } else if (setting.learn_iter > 0) {
+        LearnSetting learn_setting = {
+            .iteration = setting.learn_iter,
+            .threads   = setting.threads,
+            .eval_file = EVAL_FILE,
+            .game_file = setting.game_file,
+            .record_file = setting.record_file,
+            .seed      = setting.seed,
+            .metrics_file = setting.metrics_file,
+            .checkpoint_file = setting.checkpoint_file,
+            .resume    = setting.resume,
+            .node_budget = setting.node_budget,
+            .time_budget = setting.time_budget,
+        };
+        learn(evaluator, com, &learn_setting);
     } else {
         play(board, com, &setting);
     }
 
+    if (tracing && !Trace_stop(setting.trace_file)) {
+        printf("failed to write %s\n", setting.trace_file);
+    }
+
+    if (bench_result) {
+        if (!BenchResult_save(bench_result, setting.result_file)) {
+            printf("failed to write %s\n", setting.result_file);
+            status = EXIT_FAILURE;
+        }
+        BenchResult_delete(bench_result);
+    }
+
     Com_delete(com);
 
+    if (endcache) {
+        if (setting.endcache_file && !EndCache_save(endcache, setting.endcache_file)) {
+            printf("failed to save %s\n", setting.endcache_file);
+        }
+        EndCache_delete(endcache);
+    }
+
     Evaluator_delete(evaluator);
 
     Board_delete(board);
 
-    return 0;
+    return status;
+}
+
+///
+/// @fn     run_perft
+/// @brief  1手から指定した手数までperftを実行し、末端ノード数・時間・毎秒のノード数を表示する
+/// @param[in,out]  board   盤面
+/// @param[in]      setting ゲーム設定
+/// @param[in,out]  bench_result    最後の手数の毎秒のノード数・時間を追加するベンチマーク結果（NULLのとき追加しない）
+/// @retval true    すべての手数で既知の末端ノード数と一致（既知でない手数は比較しない）
+/// @retval false   不一致、または開始局面の形式が不正
+///
+static bool run_perft(Board *board, const Setting *setting, BenchResult *bench_result)
+{
+    int color = BLACK;
+
+    if (!setting->position) {
+        Board_init(board);
+    } else if (!Board_set(board, setting->position, &color)) {
+        printf("invalid position : %s\n", setting->position);
+        return false;
+    }
+
+    bool result = true;
+
+    printf("depth %20s %10s %14s\n", "leaves", "time[s]", "nodes/s");
+    for (int depth = 1; depth <= setting->perft_depth; depth++) {
+        struct timespec start, end;
+        timespec_get(&start, TIME_UTC);
+        uint64_t count = perft(board, color, depth, setting->perft_bulk);
+        timespec_get(&end, TIME_UTC);
+
+        double time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+        printf("%5d %20llu %10.3f %14.0f", depth, (unsigned long long)count, time,
+               (time > 0) ? (count / time) : 0.0);
+
+        // 既知の末端ノード数は初期局面からのもののみ
+        uint64_t expected = setting->position ? 0 : perft_reference(depth);
+        if (expected == 0) {
+            printf("\n");
+        } else if (count == expected) {
+            printf("  OK\n");
+        } else {
+            printf("  NG (expected %llu)\n", (unsigned long long)expected);
+            result = false;
+        }
+
+        if (bench_result && (depth == setting->perft_depth) && (time > 0)) {
+            char name[64];
+            const char *mode = setting->perft_bulk ? "perft_bulk" : "perft";
+            snprintf(name, sizeof(name), "%s.d%d.nps", mode, depth);
+            BenchResult_add(bench_result, name, "nodes/s", count / time, 0, true);
+            snprintf(name, sizeof(name), "%s.d%d.time", mode, depth);
+            BenchResult_add(bench_result, name, "s", time, 0, false);
+        }
+    }
+
+    return result;
+}
+
+///
+/// @fn     run_compare
+/// @brief  2つのベンチマーク結果を比較する
+/// @param[in]  setting ゲーム設定
+/// @retval true    悪化した計測項目がない
+/// @retval false   悪化した計測項目がある、または読み込みに失敗
+///
+static bool run_compare(const Setting *setting)
+{
+    BenchResult *base    = BenchResult_load(setting->compare_base);
+    BenchResult *current = BenchResult_load(setting->compare_file);
+    bool result = false;
+
+    if (!base) {
+        printf("failed to load %s\n", setting->compare_base);
+    } else if (!current) {
+        printf("failed to load %s\n", setting->compare_file);
+    } else {
+        int regressions = BenchResult_compare(base, current, setting->threshold);
+        printf("%d regression(s) beyond %.1f%% or missing metric(s)\n", regressions, setting->threshold);
+        result = (regressions == 0);
+    }
+
+    BenchResult_delete(base);
+    BenchResult_delete(current);
+
+    return result;
+}
+
+///
+/// @fn     append_record
+/// @brief  棋譜をファイルへ1局追記する
+/// @param[in]  file    棋譜ファイル名（拡張子が`.txt`のとき文字列形式、それ以外はバイナリ形式）
+/// @param[in]  record  棋譜
+/// @retval true    追記成功
+/// @retval false   追記失敗
+///
+static bool append_record(const char *file, const Record *record)
+{
+    const bool text = Record_is_text(file);
+    FILE *fp = fopen(file, text ? "a" : "ab");
+    if (!fp) {
+        return false;
+    }
+
+    bool result = text ? Record_write_text(fp, record) : Record_write(fp, record);
+
+    return (fclose(fp) == 0) && result;
+}
+
+///
+/// @fn     write_positions
+/// @brief  棋譜の各着手前の局面を1行ずつ書き出す
+/// @param[in]      fp      出力ストリーム
+/// @param[in,out]  board   作業用の盤面
+/// @param[in]      record  棋譜
+/// @param[in]      colors  各着手の手番色
+/// @retval true    出力成功
+/// @retval false   出力失敗
+/// @note   形式はBoard_setと同じ（64文字の局面と手番）
+///
+static bool write_positions(FILE *fp, Board *board, const Record *record, const int *colors)
+{
+    char line[BOARD_SIZE * BOARD_SIZE + 3];
+
+    Board_init(board);
+    for (int i = 0; i < record->num; i++) {
+        for (int pos = 0; pos < (BOARD_SIZE * BOARD_SIZE); pos++) {
+            int disk = Board_disk(board, Board_pos(pos % BOARD_SIZE, pos / BOARD_SIZE));
+            line[pos] = (disk == BLACK) ? 'X' : (disk == WHITE) ? 'O' : '-';
+        }
+        line[BOARD_SIZE * BOARD_SIZE]     = (colors[i] == BLACK) ? 'X' : 'O';
+        line[BOARD_SIZE * BOARD_SIZE + 1] = '\n';
+        line[BOARD_SIZE * BOARD_SIZE + 2] = '\0';
+        if (fputs(line, fp) == EOF) {
+            return false;
+        }
+        Board_flip(board, colors[i], record->moves[i]);
+    }
+
+    return true;
+}
+
+///
+/// @fn     run_convert
+/// @brief  棋譜ファイルを1局ずつ読み込み、有効な棋譜を別の形式・局面集として書き出す
+/// @param[in]  setting ゲーム設定
+/// @retval true    変換成功
+/// @retval false   入出力に失敗
+/// @note   無効な着手を含む棋譜は書き出さず、その数を表示する
+///
+static bool run_convert(const Setting *setting)
+{
+    RecordReader *reader = RecordReader_open(setting->convert_file);
+    if (!reader) {
+        printf("failed to open %s\n", setting->convert_file);
+        return false;
+    }
+
+    const bool text = setting->positions || Record_is_text(setting->convert_out);
+    FILE *fp = fopen(setting->convert_out, text ? "w" : "wb");
+    if (!fp) {
+        printf("failed to open %s\n", setting->convert_out);
+        RecordReader_close(reader);
+        return false;
+    }
+
+    Record record;
+    Board  *board = Board_create();
+    int    colors[MAX_RECORD_MOVES];
+    long   games = 0;
+    bool   result = true;
+
+    while (result && RecordReader_next(reader, &record, board, colors)) {
+        if (setting->positions) {
+            result = write_positions(fp, board, &record, colors);
+        } else if (text) {
+            result = Record_write_text(fp, &record);
+        } else {
+            result = Record_write(fp, &record);
+        }
+        games++;
+    }
+
+    printf("%ld games written to %s (%ld invalid)\n", games, setting->convert_out,
+           RecordReader_count_invalid(reader));
+
+    if ((fclose(fp) != 0) || !result) {
+        printf("failed to write %s\n", setting->convert_out);
+        result = false;
+    }
+    RecordReader_close(reader);
+    Board_delete(board);
+
+    return result;
 }
@@ -0,0 +1,86 @@
+///
+/// @file   perft.c
+/// @brief  着手生成の検証・計測（perft）
+/// @author kentakuramochi
+///
+
+#include "perft.h"
+
+///
+/// @def    NUM_REFERENCE
+/// @brief  既知の末端ノード数の手数
+///
+#define NUM_REFERENCE 12
+
+///
+/// @var    reference
+/// @brief  初期局面からの既知の末端ノード数（パスを1手と数える）
+///
+static const uint64_t reference[NUM_REFERENCE + 1] = {
+    1,
+    4,
+    12,
+    56,
+    244,
+    1396,
+    8200,
+    55092,
+    390216,
+    3005288,
+    24571284,
+    212258800,
+    1939886636,
+};
+
+uint64_t perft(Board *board, int color, int depth, bool bulk)
+{
+    if (depth == 0) {
+        return 1;
+    }
+
+    int opponent = Board_opponent(color);
+
+    // 最後の1手は有効手数を数える（有効手がなければパスまたは終局の1ノード）
+    if (bulk && (depth == 1)) {
+        uint64_t moves = Board_legal_moves(board, color);
+        uint64_t count = 0;
+        for (; moves; moves &= (moves - 1)) {
+            count++;
+        }
+        return count ? count : 1;
+    }
+
+    uint64_t count = 0;
+    bool     can_move = false;
+
+    // 返せる石があるマスへ着手する
+    for (int y = 0; y < BOARD_SIZE; y++) {
+        for (int x = 0; x < BOARD_SIZE; x++) {
+            if (Board_flip(board, color, Board_pos(x, y)) > 0) {
+                count += perft(board, opponent, (depth - 1), bulk);
+                Board_unflip(board);
+                can_move = true;
+            }
+        }
+    }
+
+    if (!can_move) {
+        if (!Board_can_play(board, opponent)) {
+            // 終局
+            return 1;
+        }
+        // パス
+        count = perft(board, opponent, (depth - 1), bulk);
+    }
+
+    return count;
+}
+
+uint64_t perft_reference(int depth)
+{
+    if ((depth < 0) || (depth > NUM_REFERENCE)) {
+        return 0;
+    }
+
+    return reference[depth];
+}
@@ -0,0 +1,72 @@
+///
+/// @file   random.c
+/// @brief  擬似乱数生成
+/// @author kentakuramochi
+///
+
+#include "random.h"
+
+static uint64_t splitmix64(uint64_t *x);
+static uint64_t rotl(uint64_t x, int k);
+
+///
+/// @fn     splitmix64
+/// @brief  SplitMix64で64bitの乱数を取得する
+/// @param[in,out]  x   状態
+/// @return 乱数
+/// @note   xoshiro256**の状態の初期化に使う
+///
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+///
+/// @fn     rotl
+/// @brief  左回転
+/// @param[in]  x   値
+/// @param[in]  k   回転数
+/// @return 回転した値
+///
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void Random_init(Random *random, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++) {
+        random->state[i] = splitmix64(&seed);
+    }
+}
+
+uint64_t Random_next(Random *random)
+{
+    uint64_t *s = random->state;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+int Random_int(Random *random, int max)
+{
+    // 上位32bitとの積の上位32bitをとる（剰余より偏りが小さい）
+    return (int)(((Random_next(random) >> 32) * (uint64_t)max) >> 32);
+}
+
+uint64_t Random_seed(uint64_t seed, uint64_t n)
+{
+    uint64_t x = seed ^ (n * 0xD1B54A32D192ED03ULL);
+    return splitmix64(&x);
+}
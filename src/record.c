@@ -0,0 +1,232 @@
+///
+/// @file   record.c
+/// @brief  棋譜の入出力
+/// @author kentakuramochi
+///
+
+#include "record.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+void Record_init(Record *record)
+{
+    record->num    = 0;
+    record->result = 0;
+}
+
+void Record_add(Record *record, int pos)
+{
+    if (record->num < MAX_RECORD_MOVES) {
+        record->moves[record->num++] = pos;
+    }
+}
+
+bool Record_write(FILE *fp, const Record *record)
+{
+    unsigned char buffer[MAX_RECORD_MOVES + 2];
+    int size = 0;
+
+    buffer[size++] = (unsigned char)record->num;
+    for (int i = 0; i < record->num; i++) {
+        buffer[size++] = (unsigned char)(Board_y(record->moves[i]) * BOARD_SIZE + Board_x(record->moves[i]));
+    }
+    buffer[size++] = (unsigned char)(signed char)record->result;
+
+    return (fwrite(buffer, 1, size, fp) == (size_t)size);
+}
+
+bool Record_read(FILE *fp, Record *record)
+{
+    unsigned char buffer[MAX_RECORD_MOVES + 1];
+
+    int num = fgetc(fp);
+    if ((num == EOF) || (num > MAX_RECORD_MOVES)) {
+        return false;
+    }
+
+    // 着手と石数差
+    if (fread(buffer, 1, num + 1, fp) != (size_t)(num + 1)) {
+        return false;
+    }
+
+    record->num = num;
+    for (int i = 0; i < num; i++) {
+        if (buffer[i] >= (BOARD_SIZE * BOARD_SIZE)) {
+            return false;
+        }
+        record->moves[i] = Board_pos(buffer[i] % BOARD_SIZE, buffer[i] / BOARD_SIZE);
+    }
+    record->result = (signed char)buffer[num];
+
+    return true;
+}
+
+bool Record_replay(const Record *record, Board *board, int *colors)
+{
+    int color = BLACK;
+
+    Board_init(board);
+
+    for (int i = 0; i < record->num; i++) {
+        // 着手できないときはパス
+        if (!Board_can_play(board, color)) {
+            color = Board_opponent(color);
+        }
+
+        if (Board_flip(board, color, record->moves[i]) == 0) {
+            return false;
+        }
+
+        if (colors) {
+            colors[i] = color;
+        }
+        color = Board_opponent(color);
+    }
+
+    return true;
+}
+
+///
+/// @struct RecordReader_
+/// @brief  棋譜ファイルの読み込み器
+///
+struct RecordReader_ {
+    FILE *fp;       ///< 棋譜ファイル
+    bool text;      ///< 文字列形式か
+    long invalid;   ///< 読み飛ばした棋譜の数
+};
+
+void Record_format(const Record *record, char *text)
+{
+    int n = 0;
+
+    for (int i = 0; i < record->num; i++) {
+        text[n++] = (char)('a' + Board_x(record->moves[i]));
+        text[n++] = (char)('1' + Board_y(record->moves[i]));
+    }
+    text[n] = '\0';
+}
+
+bool Record_parse(Record *record, const char *text)
+{
+    Record_init(record);
+
+    for (const char *c = text; *c; c++) {
+        if ((*c == ' ') || (*c == '\t') || (*c == '\n') || (*c == '\r')) {
+            continue;
+        }
+
+        int x = tolower((unsigned char)c[0]) - 'a';
+        int y = c[1] - '1';
+        if ((x < 0) || (x >= BOARD_SIZE) || (y < 0) || (y >= BOARD_SIZE) ||
+            (record->num >= MAX_RECORD_MOVES)) {
+            return false;
+        }
+        record->moves[record->num++] = Board_pos(x, y);
+        c++;
+    }
+
+    return true;
+}
+
+bool Record_write_text(FILE *fp, const Record *record)
+{
+    char text[MAX_RECORD_TEXT];
+    Record_format(record, text);
+
+    return (fprintf(fp, "%s\n", text) > 0);
+}
+
+bool Record_is_text(const char *file)
+{
+    size_t len = strlen(file);
+
+    return (len >= 4) && (strcmp(file + len - 4, ".txt") == 0);
+}
+
+RecordReader *RecordReader_open(const char *file)
+{
+    RecordReader *reader = malloc(sizeof(RecordReader));
+    if (!reader) {
+        return NULL;
+    }
+
+    reader->fp = fopen(file, "rb");
+    if (!reader->fp) {
+        free(reader);
+        return NULL;
+    }
+
+    // バイナリ形式の先頭は着手数（MAX_RECORD_MOVES以下）で英字にならない
+    int c = fgetc(reader->fp);
+    reader->text    = Record_is_text(file) || isalpha(c);
+    reader->invalid = 0;
+    rewind(reader->fp);
+
+    return reader;
+}
+
+void RecordReader_close(RecordReader *reader)
+{
+    if (!reader) {
+        return;
+    }
+
+    fclose(reader->fp);
+    free(reader);
+    reader = NULL;
+}
+
+void RecordReader_rewind(RecordReader *reader)
+{
+    rewind(reader->fp);
+    reader->invalid = 0;
+}
+
+bool RecordReader_next(RecordReader *reader, Record *record, Board *board, int *colors)
+{
+    char line[MAX_RECORD_TEXT * 2];
+
+    while (true) {
+        if (reader->text) {
+            if (!fgets(line, sizeof(line), reader->fp)) {
+                return false;
+            }
+
+            // 長すぎる行は残りを読み飛ばし、不正な形式とする
+            bool valid = (strchr(line, '\n') != NULL) || feof(reader->fp);
+            if (!valid) {
+                int c;
+                while (((c = fgetc(reader->fp)) != EOF) && (c != '\n')) {
+                }
+            }
+
+            const char *p = line + strspn(line, " \t\r\n");
+            if ((*p == '\0') || (*p == '#')) {
+                continue;
+            }
+
+            if (valid && Record_parse(record, p) && Record_replay(record, board, colors)) {
+                record->result = Board_count_disks(board, BLACK) - Board_count_disks(board, WHITE);
+                return true;
+            }
+        } else {
+            // バイナリ形式は着手数で区切るため、破損したら以降は読めない
+            if (!Record_read(reader->fp, record)) {
+                return false;
+            }
+            if (Record_replay(record, board, colors)) {
+                return true;
+            }
+        }
+
+        reader->invalid++;
+    }
+}
+
+long RecordReader_count_invalid(const RecordReader *reader)
+{
+    return reader->invalid;
+}
@@ -0,0 +1,179 @@
+///
+/// @file   safefile.c
+/// @brief  書き込み途中で中断しても壊れないファイル出力
+/// @author kentakuramochi
+///
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "safefile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+///
+/// @def    TEMP_SUFFIX
+/// @brief  一時ファイル名の接尾辞
+///
+#define TEMP_SUFFIX ".tmp"
+
+static char *temp_name(const char *file);
+static void sync_dir(const char *file);
+static bool replace_file(const char *tmp, const char *file);
+
+///
+/// @fn     temp_name
+/// @brief  一時ファイル名を生成する
+/// @param[in]  file    ファイル名
+/// @return 一時ファイル名（呼び出し側で解放する、失敗時はNULL）
+///
+static char *temp_name(const char *file)
+{
+    size_t len  = strlen(file);
+    char   *tmp = malloc(len + sizeof(TEMP_SUFFIX));
+
+    if (tmp) {
+        memcpy(tmp, file, len);
+        memcpy(tmp + len, TEMP_SUFFIX, sizeof(TEMP_SUFFIX));
+    }
+
+    return tmp;
+}
+
+///
+/// @fn     sync_dir
+/// @brief  ファイルのあるディレクトリをディスクへ書き込む
+/// @param[in]  file    ファイル名
+/// @note   名前の変更を確定させるため。失敗しても置き換え自体は完了している
+///         Windowsではディレクトリを開けないため、置き換え時に書き込みを待つ
+///
+static void sync_dir(const char *file)
+{
+#ifdef _WIN32
+    (void)file;
+#else
+    const char *slash = strrchr(file, '/');
+    char       *dir;
+
+    if (!slash) {
+        dir = malloc(2);
+        if (dir) {
+            strcpy(dir, ".");
+        }
+    } else {
+        size_t len = (slash == file) ? 1 : (size_t)(slash - file);
+        dir = malloc(len + 1);
+        if (dir) {
+            memcpy(dir, file, len);
+            dir[len] = '\0';
+        }
+    }
+    if (!dir) {
+        return;
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    free(dir);
+#endif
+}
+
+///
+/// @fn     replace_file
+/// @brief  一時ファイルの名前を変更して元のファイルと置き換える
+/// @param[in]  tmp     一時ファイル名
+/// @param[in]  file    ファイル名
+/// @retval true    置き換え成功
+/// @retval false   置き換え失敗
+/// @note   Windowsのrenameは既存のファイルを置き換えられないため、MoveFileExAを使う
+///
+static bool replace_file(const char *tmp, const char *file)
+{
+#ifdef _WIN32
+    return MoveFileExA(tmp, file, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tmp, file) == 0;
+#endif
+}
+
+FILE *SafeFile_open(const char *file)
+{
+    char *tmp = temp_name(file);
+    if (!tmp) {
+        return NULL;
+    }
+
+    FILE *fp = fopen(tmp, "wb");
+
+    free(tmp);
+
+    return fp;
+}
+
+bool SafeFile_close(FILE *fp, const char *file, bool result)
+{
+    char *tmp = temp_name(file);
+
+    // 内容をディスクへ書き込んでから閉じる
+    result = result && SafeFile_sync(fp);
+    if (fclose(fp) != 0) {
+        result = false;
+    }
+
+    if (!tmp) {
+        return false;
+    }
+
+    if (result) {
+        // 同じファイルシステム内の名前の変更は不可分に行われる
+        result = replace_file(tmp, file);
+        if (result) {
+            sync_dir(file);
+        }
+    }
+    if (!result) {
+        remove(tmp);
+    }
+
+    free(tmp);
+
+    return result;
+}
+
+bool SafeFile_sync(FILE *fp)
+{
+    if (fflush(fp) != 0) {
+        return false;
+    }
+
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+bool SafeFile_truncate(FILE *fp, long size)
+{
+    if (fflush(fp) != 0) {
+        return false;
+    }
+
+#ifdef _WIN32
+    return _chsize_s(_fileno(fp), size) == 0;
+#else
+    return ftruncate(fileno(fp), (off_t)size) == 0;
+#endif
+}
@@ -0,0 +1,222 @@
+///
+/// @file   trace.c
+/// @brief  探索の区間計測（Chrome trace形式）
+/// @author kentakuramochi
+///
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+///
+/// @def    TRACE_BUFFER_SIZE
+/// @brief  スレッドごとに記録する区間数（2の冪乗）
+/// @note   超えたら古い区間から上書きする
+///
+#define TRACE_BUFFER_SIZE (1 << 16)
+
+///
+/// @def    TRACE_STACK_SIZE
+/// @brief  入れ子にできる区間数
+///
+#define TRACE_STACK_SIZE 32
+
+///
+/// @struct TraceEvent
+/// @brief  計測した区間
+///
+typedef struct {
+    const char *name;   ///< 区間名
+    int        arg;     ///< 区間の引数
+    uint64_t   start;   ///< 開始時刻[ns]
+    uint64_t   duration;    ///< 時間[ns]
+} TraceEvent;
+
+///
+/// @struct TraceScope
+/// @brief  計測中の区間
+///
+typedef struct {
+    const char *name;   ///< 区間名
+    int        arg;     ///< 区間の引数
+    uint64_t   start;   ///< 開始時刻[ns]
+    bool       record;  ///< 記録するか
+} TraceScope;
+
+///
+/// @struct TraceBuffer
+/// @brief  スレッドごとの区間の記録（リングバッファ）
+/// @note   書き込みは所有するスレッドのみが行うためロックしない
+///
+typedef struct TraceBuffer_ {
+    int        tid;     ///< スレッド番号
+    uint64_t   head;    ///< 記録した区間数の累計
+    TraceEvent events[TRACE_BUFFER_SIZE];   ///< 区間
+    TraceScope stack[TRACE_STACK_SIZE];     ///< 計測中の区間
+    int        depth;   ///< 計測中の区間数
+    int        count;   ///< 標本化の計数
+    struct TraceBuffer_ *next;  ///< 次のスレッドの記録
+} TraceBuffer;
+
+static bool     enabled = false;    ///< 計測中か
+static int      interval = 1;       ///< 標本化の間隔
+static uint64_t origin;             ///< 計測開始時刻[ns]
+static _Atomic(TraceBuffer *) buffers = NULL;   ///< 全スレッドの記録
+static atomic_int num_threads = 0;  ///< 記録を持つスレッド数
+static _Thread_local TraceBuffer *local = NULL; ///< このスレッドの記録
+
+static uint64_t now(void);
+static TraceBuffer *get_buffer(void);
+
+///
+/// @fn     now
+/// @brief  区間計測用の時刻を取得する
+/// @return 時刻[ns]
+///
+static uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+///
+/// @fn     get_buffer
+/// @brief  このスレッドの記録を取得する
+/// @return スレッドの記録（確保できないときはNULL）
+/// @note   初回に確保し、全スレッドの記録へロックせずに追加する
+///
+static TraceBuffer *get_buffer(void)
+{
+    if (local) {
+        return local;
+    }
+
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->tid = atomic_fetch_add(&num_threads, 1) + 1;
+
+    buffer->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &buffer->next, buffer)) {
+    }
+
+    local = buffer;
+
+    return local;
+}
+
+bool Trace_start(int sample)
+{
+#if USE_TRACE
+    interval = (sample > 0) ? sample : 1;
+    origin   = now();
+    enabled  = true;
+
+    return true;
+#else
+    (void)sample;
+
+    return false;
+#endif
+}
+
+bool Trace_stop(const char *file)
+{
+    if (!enabled) {
+        return false;
+    }
+    enabled = false;
+
+    FILE *fp = fopen(file, "w");
+    bool first = true;
+
+    if (fp) {
+        fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    }
+
+    TraceBuffer *buffer = atomic_exchange(&buffers, NULL);
+    while (buffer) {
+        // 上書きされていなければ先頭から、上書きされていれば最も古い区間から書き出す
+        uint64_t begin = (buffer->head > TRACE_BUFFER_SIZE) ? (buffer->head - TRACE_BUFFER_SIZE) : 0;
+        for (uint64_t i = begin; fp && (i < buffer->head); i++) {
+            const TraceEvent *e = &buffer->events[i & (TRACE_BUFFER_SIZE - 1)];
+            fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                    (first ? "" : ",\n"), e->name, buffer->tid,
+                    (e->start - origin) * 1e-3, e->duration * 1e-3);
+            if (e->arg >= 0) {
+                fprintf(fp, ", \"args\": {\"arg\": %d}", e->arg);
+            }
+            fprintf(fp, "}");
+            first = false;
+        }
+
+        TraceBuffer *next = buffer->next;
+        free(buffer);
+        buffer = next;
+    }
+    local = NULL;
+    atomic_store(&num_threads, 0);
+
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "\n]}\n");
+
+    return (fclose(fp) == 0);
+}
+
+void Trace_begin(const char *name, int arg, bool sampled)
+{
+    if (!enabled) {
+        return;
+    }
+
+    TraceBuffer *buffer = get_buffer();
+    if (!buffer) {
+        return;
+    }
+
+    // 入れ子が深すぎる区間は記録しないが、終了との対応は保つ
+    int depth = buffer->depth++;
+    if (depth >= TRACE_STACK_SIZE) {
+        return;
+    }
+
+    TraceScope *scope = &buffer->stack[depth];
+    scope->record = !sampled || ((buffer->count++ % interval) == 0);
+    if (scope->record) {
+        scope->name  = name;
+        scope->arg   = arg;
+        scope->start = now();
+    }
+}
+
+void Trace_end(void)
+{
+    if (!enabled || !local || (local->depth <= 0)) {
+        return;
+    }
+
+    int depth = --local->depth;
+    if (depth >= TRACE_STACK_SIZE) {
+        return;
+    }
+
+    const TraceScope *scope = &local->stack[depth];
+    if (scope->record) {
+        TraceEvent *e = &local->events[(local->head++) & (TRACE_BUFFER_SIZE - 1)];
+        e->name     = scope->name;
+        e->arg      = scope->arg;
+        e->start    = scope->start;
+        e->duration = now() - scope->start;
+    }
+}